@@ -0,0 +1,52 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <cstddef>
+
+// Counts the calls to the global `operator new` (replaced in `allocation_counter.cpp`)
+// and reports them as per-iteration benchmark counters.
+
+namespace bench {
+
+inline std::atomic<std::size_t> allocations_count = 0;
+inline std::atomic<std::size_t> allocated_bytes = 0;
+
+class allocation_counter {
+  std::size_t start_count_ = allocations_count.load(std::memory_order_relaxed);
+  std::size_t start_bytes_ = allocated_bytes.load(std::memory_order_relaxed);
+public:
+  // Should be called after the benchmark loop
+  void report(benchmark::State& state) const
+  {
+    const auto count = allocations_count.load(std::memory_order_relaxed) - start_count_;
+    const auto bytes = allocated_bytes.load(std::memory_order_relaxed) - start_bytes_;
+    state.counters["allocs"] = benchmark::Counter(static_cast<double>(count), benchmark::Counter::kAvgIterations);
+    state.counters["bytes"] = benchmark::Counter(static_cast<double>(bytes), benchmark::Counter::kAvgIterations);
+  }
+};
+
+}  // namespace bench
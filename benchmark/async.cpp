@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/async.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+namespace {
+
+// latency of offloading a trivial function to the pool and getting the result back on the calling thread
+void async_round_trip(benchmark::State& state)
+{
+  mp_coro::static_thread_pool pool(1);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::async(pool, [] { return 42; })));
+  allocs.report(state);
+}
+
+// cost of the consecutive offloads done from inside of the pool
+void async_chain(benchmark::State& state)
+{
+  mp_coro::static_thread_pool pool(static_cast<std::size_t>(state.range(0)));
+  constexpr std::int64_t count = 1024;
+  auto body = [&]() -> mp_coro::task<std::int64_t> {
+    std::int64_t result = 0;
+    for (std::int64_t i = 0; i < count; ++i) result += co_await mp_coro::async(pool, [i] { return i; });
+    co_return result;
+  };
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(body()));
+  state.SetItemsProcessed(state.iterations() * count);
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(async_round_trip)->UseRealTime();
+BENCHMARK(async_chain)->Arg(1)->Arg(4)->UseRealTime();
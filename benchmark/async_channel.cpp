@@ -0,0 +1,88 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/async_channel.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+constexpr std::int64_t items = 1 << 16;
+
+mp_coro::task<> producer(mp_coro::static_thread_pool& pool, mp_coro::async_channel<std::int64_t>& ch,
+                         std::int64_t count)
+{
+  co_await pool.schedule();
+  for (std::int64_t i = 0; i < count; ++i) co_await ch.send(i);
+}
+
+mp_coro::task<int> produce_and_close(mp_coro::static_thread_pool& pool, mp_coro::async_channel<std::int64_t>& ch,
+                                     int producers)
+{
+  std::vector<mp_coro::task<>> tasks;
+  for (int i = 0; i < producers; ++i) tasks.push_back(producer(pool, ch, items / producers));
+  co_await mp_coro::when_all(std::move(tasks));
+  ch.close();
+  co_return producers;
+}
+
+mp_coro::task<std::int64_t> consumer(mp_coro::static_thread_pool& pool, mp_coro::async_channel<std::int64_t>& ch)
+{
+  co_await pool.schedule();
+  std::int64_t sum = 0;
+  while (auto v = co_await ch.receive()) sum += *v;
+  co_return sum;
+}
+
+// `items` values sent by `state.range(0)` producers and received by `state.range(1)` consumers through
+// a channel with the capacity of `state.range(2)`
+void async_channel_throughput(benchmark::State& state)
+{
+  const auto producers = static_cast<int>(state.range(0));
+  const auto consumers = static_cast<int>(state.range(1));
+  mp_coro::static_thread_pool pool(static_cast<unsigned>(producers + consumers));
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    mp_coro::async_channel<std::int64_t> ch(static_cast<std::size_t>(state.range(2)));
+    std::vector<mp_coro::task<std::int64_t>> receivers;
+    for (int i = 0; i < consumers; ++i) receivers.push_back(consumer(pool, ch));
+    auto all = mp_coro::when_all(produce_and_close(pool, ch, producers), mp_coro::when_all(std::move(receivers)));
+    benchmark::DoNotOptimize(mp_coro::sync_await(std::move(all)));
+  }
+  state.SetItemsProcessed(state.iterations() * items);
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(async_channel_throughput)
+  ->ArgNames({"producers", "consumers", "capacity"})
+  ->ArgsProduct({{1, 2, 4}, {1, 2, 4}, {16, 1024}})
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
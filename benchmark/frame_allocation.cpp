@@ -0,0 +1,74 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/recycling_allocator.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Compares the throughput of coroutine frames creation (frames/s reported as `items_per_second`) for:
+// - the default frame allocation (recycled when `MP_CORO_FRAME_RECYCLING` is enabled)
+// - `std::allocator` (always the system allocator)
+// - `mp_coro::recycling_allocator`
+
+namespace {
+
+template<typename Allocator>
+mp_coro::task<std::int64_t, Allocator> leaf(std::int64_t i)
+{
+  co_return i;
+}
+
+template<typename Allocator>
+mp_coro::task<std::int64_t> sum(std::int64_t count)
+{
+  std::int64_t result = 0;
+  for (std::int64_t i = 0; i < count; ++i) result += co_await leaf<Allocator>(i);
+  co_return result;
+}
+
+template<typename Allocator>
+void frames(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(sum<Allocator>(count)));
+  state.SetItemsProcessed(state.iterations() * count);
+  allocs.report(state);
+}
+
+#if MP_CORO_FRAME_RECYCLING
+constexpr const char* default_name = "frames/default(recycling)";
+#else
+constexpr const char* default_name = "frames/default(system)";
+#endif
+
+}  // namespace
+
+BENCHMARK_TEMPLATE(frames, void)->Name(default_name)->Arg(1024);
+BENCHMARK_TEMPLATE(frames, std::allocator<std::byte>)->Name("frames/std::allocator")->Arg(1024);
+BENCHMARK_TEMPLATE(frames, mp_coro::recycling_allocator<>)->Name("frames/recycling_allocator")->Arg(1024);
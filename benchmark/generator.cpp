@@ -0,0 +1,193 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/async_generator.h>
+#include <mp-coro/chunked_generator.h>
+#include <mp-coro/generator.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstdint>
+#include <span>
+
+namespace {
+
+mp_coro::generator<std::int64_t> iota(std::int64_t count)
+{
+  for (std::int64_t i = 0; i < count; ++i) co_yield i;
+}
+
+// the baseline
+void plain_loop(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    for (std::int64_t i = 0; i < count; ++i) {
+      benchmark::DoNotOptimize(i);
+      sum += i;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+void generator_iteration(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    for (auto i : iota(count)) {
+      benchmark::DoNotOptimize(i);
+      sum += i;
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+  allocs.report(state);
+}
+
+mp_coro::generator<std::int64_t> samples(std::int64_t count)
+{
+  for (std::int64_t i = 0; i < count; ++i) co_yield i;
+}
+
+mp_coro::chunked_generator<std::int64_t> chunked_samples(std::int64_t count)
+{
+  std::array<std::int64_t, 256> buffer;
+  for (std::int64_t i = 0; i < count;) {
+    std::size_t size = 0;
+    for (; size < buffer.size() && i < count; ++size, ++i) buffer[size] = i;
+    co_yield std::span<const std::int64_t>(buffer.data(), size);
+  }
+}
+
+// one resumption per element
+void generator_sum(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    for (std::int64_t v : samples(count)) sum += v;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// one resumption per chunk with the elements consumed through the flat view
+void chunked_generator_sum(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    for (std::int64_t v : chunked_samples(count)) sum += v;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// the same with a tight loop over each chunk
+void chunked_generator_sum_chunks(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  for (auto _ : state) {
+    std::int64_t sum = 0;
+    auto gen = chunked_samples(count);
+    for (std::span<const std::int64_t> chunk : gen.chunks())
+      for (std::int64_t v : chunk) sum += v;
+    benchmark::DoNotOptimize(sum);
+  }
+  state.SetItemsProcessed(state.iterations() * count);
+}
+
+// a chain of `depth` nested generators yielding one element at each level
+mp_coro::generator<std::int64_t> nested_reyield(std::int64_t depth)
+{
+  co_yield depth;
+  if (depth > 1)
+    for (auto i : nested_reyield(depth - 1)) co_yield i;
+}
+
+mp_coro::generator<std::int64_t> nested_elements_of(std::int64_t depth)
+{
+  co_yield depth;
+  if (depth > 1) co_yield mp_coro::elements_of(nested_elements_of(depth - 1));
+}
+
+// every element passes through all of the enclosing generators (O(depth) per element)
+void generator_nested_reyield(benchmark::State& state)
+{
+  const auto depth = state.range(0);
+  for (auto _ : state)
+    for (auto i : nested_reyield(depth)) benchmark::DoNotOptimize(i);
+  state.SetItemsProcessed(state.iterations() * depth);
+}
+
+// the innermost generator is resumed directly (O(1) per element)
+void generator_nested_elements_of(benchmark::State& state)
+{
+  const auto depth = state.range(0);
+  for (auto _ : state)
+    for (auto i : nested_elements_of(depth)) benchmark::DoNotOptimize(i);
+  state.SetItemsProcessed(state.iterations() * depth);
+}
+
+mp_coro::async_generator<std::int64_t> async_iota(std::int64_t count)
+{
+  for (std::int64_t i = 0; i < count; ++i) co_yield i;
+}
+
+mp_coro::task<std::int64_t> async_sum(std::int64_t count)
+{
+  std::int64_t sum = 0;
+  auto gen = async_iota(count);
+  for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it) {
+    benchmark::DoNotOptimize(*it);
+    sum += *it;
+  }
+  co_return sum;
+}
+
+// the cost of the symmetric transfer to the generator and back for each element
+void async_generator_iteration(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(async_sum(count)));
+  state.SetItemsProcessed(state.iterations() * count);
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(plain_loop)->RangeMultiplier(16)->Range(1, 1 << 16);
+BENCHMARK(generator_iteration)->RangeMultiplier(16)->Range(1, 1 << 16);
+BENCHMARK(generator_sum)->Arg(1 << 16);
+BENCHMARK(chunked_generator_sum)->Arg(1 << 16);
+BENCHMARK(chunked_generator_sum_chunks)->Arg(1 << 16);
+BENCHMARK(generator_nested_reyield)->RangeMultiplier(8)->Range(1, 1 << 12);
+BENCHMARK(generator_nested_elements_of)->RangeMultiplier(8)->Range(1, 1 << 12);
+BENCHMARK(async_generator_iteration)->RangeMultiplier(16)->Range(1, 1 << 16);
@@ -0,0 +1,138 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/buffer_pool.h>
+#include <mp-coro/io_context.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <benchmark/benchmark.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t block_size = 4096;
+constexpr std::size_t file_blocks = 4096;  // 16 MiB (kept in the page cache)
+
+// a temporary file shared by all of the benchmarks
+class test_file {
+  std::filesystem::path path_ = std::filesystem::temp_directory_path() / "mp_coro_io_context_benchmark.bin";
+  int fd_;
+public:
+  test_file()
+  {
+    fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    const std::vector<std::byte> block(block_size, std::byte{42});
+    for (std::size_t i = 0; i < file_blocks; ++i)
+      if (::pwrite(fd_, block.data(), block.size(), static_cast<off_t>(i * block_size)) < 0) break;
+  }
+  ~test_file()
+  {
+    ::close(fd_);
+    std::filesystem::remove(path_);
+  }
+  int fd() const { return fd_; }
+};
+
+const test_file& file()
+{
+  static const test_file f;
+  return f;
+}
+
+std::uint64_t offset(std::size_t i) { return (i * 7919 % file_blocks) * block_size; }
+
+// baseline: blocking reads on the calling thread
+void pread_loop(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::array<std::byte, block_size> buffer;
+  for (auto _ : state)
+    for (std::size_t i = 0; i < count; ++i)
+      benchmark::DoNotOptimize(::pread(file().fd(), buffer.data(), buffer.size(), static_cast<off_t>(offset(i))));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(block_size));
+}
+
+mp_coro::task<std::size_t> read_block(mp_coro::io_context& ctx, std::span<std::byte> buffer, std::uint64_t offset)
+{
+  co_return co_await ctx.async_read(file().fd(), buffer, offset);
+}
+
+// `state.range(0)` reads in flight at the same time
+void io_context_read(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  mp_coro::io_context ctx(1024);
+  std::vector<std::byte> buffers(count * block_size);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<mp_coro::task<std::size_t>> reads;
+    reads.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+      reads.push_back(read_block(ctx, std::span(buffers).subspan(i * block_size, block_size), offset(i)));
+    benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::when_all(std::move(reads))));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(block_size));
+  allocs.report(state);
+}
+
+mp_coro::task<std::size_t> read_leased_block(mp_coro::buffer_pool& pool, std::uint64_t offset)
+{
+  const mp_coro::buffer_lease buffer = co_await pool.acquire();
+  co_return co_await pool.async_read(file().fd(), buffer, offset);
+}
+
+// the same reads to the registered buffers leased from a pool
+void io_context_read_fixed(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  mp_coro::io_context ctx(1024);
+  mp_coro::buffer_pool pool(ctx, count, block_size);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<mp_coro::task<std::size_t>> reads;
+    reads.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) reads.push_back(read_leased_block(pool, offset(i)));
+    benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::when_all(std::move(reads))));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<std::int64_t>(block_size));
+  state.counters["registered"] = pool.registered();
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(pread_loop)->RangeMultiplier(8)->Range(1, 4096);
+BENCHMARK(io_context_read)->RangeMultiplier(8)->Range(1, 4096)->UseRealTime();
+BENCHMARK(io_context_read_fixed)->RangeMultiplier(8)->Range(1, 4096)->UseRealTime();
@@ -0,0 +1,96 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/reactor.h>
+#include <mp-coro/socket.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace {
+
+mp_coro::task<> echo_session(mp_coro::async_socket& listener)
+{
+  mp_coro::async_socket socket = co_await listener.async_accept();
+  std::array<std::byte, 64 * 1024> buffer;
+  while (const std::size_t size = co_await socket.async_recv(buffer))
+    for (std::size_t sent = 0; sent < size;)
+      sent += co_await socket.async_send(std::span(buffer).subspan(sent, size - sent));
+}
+
+// sends the message and waits for all of it to come back
+mp_coro::task<> round_trip(mp_coro::async_socket& socket, std::span<const std::byte> message,
+                           std::span<std::byte> reply)
+{
+  std::size_t sent = 0;
+  std::size_t received = 0;
+  while (received < reply.size()) {
+    if (sent < message.size()) sent += co_await socket.async_send(message.subspan(sent));
+    received += co_await socket.async_recv(reply.subspan(received));
+  }
+}
+
+std::filesystem::path socket_path()
+{
+  return std::filesystem::temp_directory_path() / "mp_coro_socket_benchmark.sock";
+}
+
+// echo round trips of `state.range(0)` bytes over a loopback TCP (`state.range(1) == 0`) or a Unix domain socket
+void socket_echo(benchmark::State& state)
+{
+  const auto size = static_cast<std::size_t>(state.range(0));
+  const bool unix_domain = state.range(1) != 0;
+  mp_coro::reactor r;
+  std::filesystem::remove(socket_path());
+  const auto local =
+    unix_domain ? mp_coro::endpoint::unix_domain(socket_path().native()) : mp_coro::endpoint::loopback(0);
+  auto listener = mp_coro::async_socket::listen(r, local);
+  const auto server = listener.local_endpoint();
+  std::thread session([&] { mp_coro::sync_await(echo_session(listener)); });
+  {
+    auto socket = mp_coro::async_socket::open(r, server);
+    mp_coro::sync_await(socket.async_connect(server));
+    const std::vector<std::byte> message(size, std::byte{42});
+    std::vector<std::byte> reply(size);
+    const bench::allocation_counter allocs;
+    for (auto _ : state) mp_coro::sync_await(round_trip(socket, message, reply));
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * state.range(0) * 2);
+    allocs.report(state);
+  }
+  session.join();
+  std::filesystem::remove(socket_path());
+  state.SetLabel(unix_domain ? "unix" : "tcp");
+}
+
+}  // namespace
+
+BENCHMARK(socket_echo)->ArgsProduct({{64, 4096, 65536}, {0, 1}})->UseRealTime();
@@ -0,0 +1,122 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/async_channel.h>
+#include <mp-coro/spsc_channel.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+constexpr std::int64_t items = 1 << 20;
+constexpr std::size_t capacity = 1024;
+
+// the upper bound: copying the same amount of data in memory
+void memcpy_baseline(benchmark::State& state)
+{
+  std::vector<std::int64_t> src(items, 1), dst(items);
+  for (auto _ : state) {
+    std::memcpy(dst.data(), src.data(), items * sizeof(std::int64_t));
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * items);
+}
+
+template<typename Channel>
+mp_coro::task<int> producer(mp_coro::static_thread_pool& pool, Channel& ch)
+{
+  co_await pool.schedule();
+  for (std::int64_t i = 0; i < items; ++i) co_await ch.send(i);
+  ch.close();
+  co_return 0;
+}
+
+template<typename Channel>
+mp_coro::task<std::int64_t> consumer(mp_coro::static_thread_pool& pool, Channel& ch)
+{
+  co_await pool.schedule();
+  std::int64_t sum = 0;
+  while (auto v = co_await ch.receive()) sum += *v;
+  co_return sum;
+}
+
+mp_coro::task<std::int64_t> batch_consumer(mp_coro::static_thread_pool& pool, mp_coro::spsc_channel<std::int64_t>& ch)
+{
+  co_await pool.schedule();
+  std::vector<std::int64_t> batch(capacity);
+  std::int64_t sum = 0;
+  while (const std::size_t count = co_await ch.receive_many(batch))
+    for (std::size_t i = 0; i < count; ++i) sum += batch[i];
+  co_return sum;
+}
+
+// one producer and one consumer passing `items` values one by one through a channel with the capacity of
+// `state.range(0)` (the capacity of 1 suspends one of the sides on nearly every value so it also stresses
+// the suspension handshake)
+template<typename Channel>
+void channel_1p1c(benchmark::State& state)
+{
+  mp_coro::static_thread_pool pool(2);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    Channel ch(static_cast<std::size_t>(state.range(0)));
+    benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::when_all(producer(pool, ch), consumer(pool, ch))));
+  }
+  state.SetItemsProcessed(state.iterations() * items);
+  allocs.report(state);
+}
+
+// the same with the consumer draining all of the available values at once
+void spsc_channel_receive_many(benchmark::State& state)
+{
+  mp_coro::static_thread_pool pool(2);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    mp_coro::spsc_channel<std::int64_t> ch(capacity);
+    benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::when_all(producer(pool, ch), batch_consumer(pool, ch))));
+  }
+  state.SetItemsProcessed(state.iterations() * items);
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(memcpy_baseline)->Unit(benchmark::kMillisecond);
+BENCHMARK(channel_1p1c<mp_coro::async_channel<std::int64_t>>)
+  ->Arg(1)
+  ->Arg(capacity)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(channel_1p1c<mp_coro::spsc_channel<std::int64_t>>)
+  ->Arg(1)
+  ->Arg(capacity)
+  ->UseRealTime()
+  ->Unit(benchmark::kMillisecond);
+BENCHMARK(spsc_channel_receive_many)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,141 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/run_loop.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <thread>
+
+namespace {
+
+mp_coro::task<int> ready() { co_return 42; }
+
+// an awaitable completing synchronously without a coroutine frame
+struct immediate {
+  static bool await_ready() noexcept { return true; }
+  static void await_suspend(std::coroutine_handle<>) noexcept {}
+  static int await_resume() noexcept { return 42; }
+};
+
+// round trip of a synchronously completing task
+void sync_await_task(benchmark::State& state)
+{
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(ready()));
+  allocs.report(state);
+}
+
+// the overhead of `sync_await` itself
+void sync_await_awaiter(benchmark::State& state)
+{
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(immediate{}));
+  allocs.report(state);
+}
+
+template<typename Scheduler>
+mp_coro::task<int> scheduled(Scheduler& scheduler)
+{
+  co_await scheduler.schedule();
+  co_return 42;
+}
+
+// a task rescheduled on the calling thread by `run_loop`
+void sync_await_run_loop(benchmark::State& state)
+{
+  mp_coro::run_loop loop;
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(loop, scheduled(loop)));
+  allocs.report(state);
+}
+
+// the same task rescheduled on a thread pool
+void sync_await_thread_pool(benchmark::State& state)
+{
+  mp_coro::static_thread_pool pool(1);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(scheduled(pool)));
+  allocs.report(state);
+}
+
+// a thread busy-polling for coroutines to resume after a short delay
+class completer {
+public:
+  explicit completer(std::chrono::nanoseconds delay) :
+      thread_([this, delay](std::stop_token stop) {
+        while (!stop.stop_requested()) {
+          auto handle = pending_.exchange(nullptr, std::memory_order_acquire);
+          if (!handle) {
+            std::this_thread::yield();
+            continue;
+          }
+          const auto end = std::chrono::steady_clock::now() + delay;
+          while (std::chrono::steady_clock::now() < end) {}
+          std::coroutine_handle<>::from_address(handle).resume();
+        }
+      })
+  {
+  }
+
+  auto complete()
+  {
+    struct awaiter {
+      completer& c;
+      static bool await_ready() noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        c.pending_.store(handle.address(), std::memory_order_release);
+      }
+      static int await_resume() noexcept { return 42; }
+    };
+    return awaiter{*this};
+  }
+
+private:
+  std::atomic<void*> pending_ = nullptr;
+  std::jthread thread_;
+};
+
+// latency of waking up the caller of `sync_await` when the work completes on another thread
+// after `state.range(0)` ns
+void sync_await_remote_completion(benchmark::State& state)
+{
+  completer c(std::chrono::nanoseconds(state.range(0)));
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(c.complete()));
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(sync_await_task);
+BENCHMARK(sync_await_awaiter);
+BENCHMARK(sync_await_run_loop);
+BENCHMARK(sync_await_thread_pool)->UseRealTime();
+BENCHMARK(sync_await_remote_completion)->Arg(0)->Arg(250)->Arg(1000)->UseRealTime();
@@ -0,0 +1,81 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+namespace {
+
+mp_coro::task<std::int64_t> leaf() { co_return 1; }
+
+mp_coro::task<std::int64_t> chain(std::int64_t depth)
+{
+  if (depth == 0) co_return co_await leaf();
+  co_return co_await chain(depth - 1) + 1;
+}
+
+// creation and destruction of a never started task
+void task_create(benchmark::State& state)
+{
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    auto t = leaf();
+    benchmark::DoNotOptimize(&t);
+  }
+  allocs.report(state);
+}
+
+// a chain of `depth` nested `co_await`s of a task
+void task_await_chain(benchmark::State& state)
+{
+  const auto depth = state.range(0);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(chain(depth)));
+  state.SetItemsProcessed(state.iterations() * (depth + 1));
+  allocs.report(state);
+}
+
+// `co_await`ing the same (already completed) task many times
+void task_await_ready(benchmark::State& state)
+{
+  const auto count = state.range(0);
+  auto body = [](std::int64_t n) -> mp_coro::task<std::int64_t> {
+    const auto t = leaf();
+    std::int64_t result = 0;
+    for (std::int64_t i = 0; i < n; ++i) result += co_await t;
+    co_return result;
+  };
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(mp_coro::sync_await(body(count)));
+  state.SetItemsProcessed(state.iterations() * count);
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(task_create);
+BENCHMARK(task_await_chain)->RangeMultiplier(4)->Range(1, 1024);
+BENCHMARK(task_await_ready)->Arg(1024);
@@ -0,0 +1,104 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/bits/timer_wheel.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/timer_service.h>
+#include <mp-coro/when_all.h>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+// cost of scheduling and cancelling a timer with `state.range(0)` timers already pending
+void timer_wheel_insert_remove(benchmark::State& state)
+{
+  const auto pending = static_cast<std::size_t>(state.range(0));
+  mp_coro::detail::timer_wheel wheel;
+  std::vector<mp_coro::detail::timer_node> nodes(pending);
+  std::mt19937_64 rng(42);
+  for (auto& node : nodes) {
+    node.expiry = 1 + rng() % (std::uint64_t{1} << 32);
+    wheel.insert(node);
+  }
+  mp_coro::detail::timer_node node;
+  std::uint64_t delay = 1;
+  for (auto _ : state) {
+    node.expiry = wheel.now() + (delay = delay * 7 % 1'000'003);
+    wheel.insert(node);
+    benchmark::DoNotOptimize(wheel.next_event());
+    wheel.remove(node);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// expiring `state.range(0)` timers spread over 16 ticks
+void timer_wheel_expire(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::vector<mp_coro::detail::timer_node> nodes(count);
+  for (auto _ : state) {
+    mp_coro::detail::timer_wheel wheel;
+    for (std::size_t i = 0; i < count; ++i) {
+      nodes[i].expiry = 1 + i % 16;
+      wheel.insert(nodes[i]);
+    }
+    std::size_t expired = 0;
+    wheel.advance(16, [&](mp_coro::detail::timer_node&) { ++expired; });
+    benchmark::DoNotOptimize(expired);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+mp_coro::task<> sleeper(mp_coro::timer_service& service, std::chrono::milliseconds duration)
+{
+  co_await service.sleep_for(duration);
+}
+
+// `state.range(0)` coroutines sleeping concurrently for up to 10 ms (including the coroutines creation)
+void timer_service_sleep(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  mp_coro::timer_service service;
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<mp_coro::task<>> tasks;
+    tasks.reserve(count);
+    for (std::size_t i = 0; i < count; ++i)
+      tasks.push_back(sleeper(service, std::chrono::milliseconds(1 + static_cast<int>(i % 10))));
+    mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  allocs.report(state);
+}
+
+}  // namespace
+
+BENCHMARK(timer_wheel_insert_remove)->RangeMultiplier(32)->Range(1, 1 << 20);
+BENCHMARK(timer_wheel_expire)->RangeMultiplier(32)->Range(1, 1 << 20);
+BENCHMARK(timer_service_sleep)->RangeMultiplier(32)->Range(1, 1 << 20)->UseRealTime()->Unit(benchmark::kMillisecond);
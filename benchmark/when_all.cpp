@@ -0,0 +1,142 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include "allocation_counter.h"
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace {
+
+mp_coro::task<int> value(int i) { co_return i; }
+mp_coro::task<> empty() { co_return; }
+
+// Not a `task` so `when_all` has to wrap it with an additional coroutine frame
+template<typename T>
+struct wrapped_task {
+  mp_coro::task<T> task;
+  decltype(auto) operator co_await() && { return std::move(task).operator co_await(); }
+};
+
+template<typename Awaitable, std::size_t... Is>
+int when_all_tuple_impl(std::index_sequence<Is...>)
+{
+  auto results = mp_coro::sync_await(mp_coro::when_all(Awaitable{value(static_cast<int>(Is))}...));
+  return std::apply([](auto... v) { return (0 + ... + v); }, results);
+}
+
+// variadic overload (tasks count known at compile-time)
+template<typename Awaitable, std::size_t N>
+void when_all_tuple(benchmark::State& state)
+{
+  const bench::allocation_counter allocs;
+  for (auto _ : state) benchmark::DoNotOptimize(when_all_tuple_impl<Awaitable>(std::make_index_sequence<N>{}));
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(N));
+  allocs.report(state);
+}
+
+// range overload including the creation of the tasks
+template<typename Awaitable>
+void when_all_range(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<Awaitable> tasks;
+    tasks.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) tasks.push_back(Awaitable{empty()});
+    mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  allocs.report(state);
+}
+
+// range overload returning the results in a new container or writing them to a user-provided buffer
+template<bool ToSpan>
+void when_all_range_results(benchmark::State& state)
+{
+  const auto count = static_cast<std::size_t>(state.range(0));
+  std::vector<int> results(ToSpan ? count : 0);
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<mp_coro::task<int>> tasks;
+    tasks.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) tasks.push_back(value(static_cast<int>(i)));
+    if constexpr (ToSpan)
+      mp_coro::sync_await(mp_coro::when_all(std::move(tasks), std::span(results)));
+    else
+      benchmark::DoNotOptimize(mp_coro::sync_await(mp_coro::when_all(std::move(tasks))));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  allocs.report(state);
+}
+
+mp_coro::task<> on_pool(mp_coro::static_thread_pool& pool) { co_await pool.schedule(); }
+
+// many tasks completing concurrently on `state.range(0)` threads
+template<typename Policy>
+void when_all_concurrent(benchmark::State& state)
+{
+  constexpr std::size_t count = 4096;
+  mp_coro::static_thread_pool pool(static_cast<std::size_t>(state.range(0)));
+  const bench::allocation_counter allocs;
+  for (auto _ : state) {
+    std::vector<mp_coro::task<>> tasks;
+    tasks.reserve(count);
+    for (std::size_t i = 0; i < count; ++i) tasks.push_back(on_pool(pool));
+    mp_coro::sync_await(mp_coro::when_all<Policy>(std::move(tasks)));
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(count));
+  allocs.report(state);
+}
+
+}  // namespace
+
+// `task` arguments notify `when_all` directly
+BENCHMARK_TEMPLATE(when_all_tuple, mp_coro::task<int>, 1);
+BENCHMARK_TEMPLATE(when_all_tuple, mp_coro::task<int>, 2);
+BENCHMARK_TEMPLATE(when_all_tuple, mp_coro::task<int>, 4);
+BENCHMARK_TEMPLATE(when_all_tuple, mp_coro::task<int>, 8);
+BENCHMARK_TEMPLATE(when_all_tuple, mp_coro::task<int>, 16);
+BENCHMARK_TEMPLATE(when_all_range, mp_coro::task<>)->RangeMultiplier(32)->Range(1, 1 << 20);
+BENCHMARK_TEMPLATE(when_all_range_results, false)->RangeMultiplier(32)->Range(1, 1 << 15);
+BENCHMARK_TEMPLATE(when_all_range_results, true)->RangeMultiplier(32)->Range(1, 1 << 15);
+
+// completion counting policies
+BENCHMARK_TEMPLATE(when_all_concurrent, mp_coro::single_counter)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+BENCHMARK_TEMPLATE(when_all_concurrent, mp_coro::sharded_counter)->RangeMultiplier(2)->Range(1, 64)->UseRealTime();
+
+// other awaitables are wrapped with a coroutine
+BENCHMARK_TEMPLATE(when_all_tuple, wrapped_task<int>, 1);
+BENCHMARK_TEMPLATE(when_all_tuple, wrapped_task<int>, 2);
+BENCHMARK_TEMPLATE(when_all_tuple, wrapped_task<int>, 4);
+BENCHMARK_TEMPLATE(when_all_tuple, wrapped_task<int>, 8);
+BENCHMARK_TEMPLATE(when_all_tuple, wrapped_task<int>, 16);
+BENCHMARK_TEMPLATE(when_all_range, wrapped_task<void>)->RangeMultiplier(32)->Range(1, 1 << 20);
@@ -82,6 +82,10 @@ macro(_set_flags)
         -Wduplicated-branches # warn if if / else branches have duplicated code
         -Wlogical-op # warn about logical operations being used where bitwise were probably wanted
     )
+    if(CMAKE_CXX_COMPILER_ID STREQUAL "GNU" AND CMAKE_CXX_COMPILER_VERSION VERSION_LESS 13)
+        # false positives for coroutine frames allocated with promise `operator new` taking `std::allocator_arg`
+        set(GCC_WARNINGS ${GCC_WARNINGS} -Wno-mismatched-new-delete)
+    endif()
 
     if(${projectPrefix}WARNINGS_AS_ERRORS)
         set(GCC_WARNINGS ${GCC_WARNINGS} -Werror)
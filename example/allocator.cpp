@@ -0,0 +1,89 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/generator.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+
+// A memory resource that reports all the allocations done by the upstream resource
+class tracing_resource : public std::pmr::memory_resource {
+  std::pmr::memory_resource* upstream_;
+public:
+  explicit tracing_resource(std::pmr::memory_resource* upstream = std::pmr::get_default_resource()) :
+      upstream_(upstream)
+  {
+  }
+private:
+  void* do_allocate(std::size_t bytes, std::size_t alignment) override
+  {
+    std::cout << "[arena] allocating " << bytes << " bytes\n";
+    return upstream_->allocate(bytes, alignment);
+  }
+  void do_deallocate(void* ptr, std::size_t bytes, std::size_t alignment) override
+  {
+    std::cout << "[arena] releasing " << bytes << " bytes\n";
+    upstream_->deallocate(ptr, bytes, alignment);
+  }
+  bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+};
+
+// an allocator provided as the first coroutine arguments
+mp_coro::task<int> leaf(std::allocator_arg_t, std::pmr::polymorphic_allocator<>, int i) { co_return i; }
+
+// the allocator type fixed in the task type
+using arena_task = mp_coro::task<int, std::pmr::polymorphic_allocator<>>;
+
+arena_task sum(std::allocator_arg_t, std::pmr::polymorphic_allocator<> alloc, int count)
+{
+  int result = 0;
+  for (int i = 0; i < count; ++i) result += co_await leaf(std::allocator_arg, alloc, i);
+  co_return result;
+}
+
+mp_coro::generator<int> iota(std::allocator_arg_t, std::pmr::polymorphic_allocator<>, int count)
+{
+  for (int i = 0; i < count; ++i) co_yield i;
+}
+
+int main()
+{
+  try {
+    tracing_resource upstream;
+    {
+      // all the coroutine frames of a "request" are served by one arena released at once
+      std::pmr::monotonic_buffer_resource arena(4096, &upstream);
+      std::pmr::polymorphic_allocator<> alloc(&arena);
+
+      std::cout << "Sum: " << mp_coro::sync_await(sum(std::allocator_arg, alloc, 10)) << '\n';
+      for (int i : iota(std::allocator_arg, alloc, 5)) std::cout << i << ' ';
+      std::cout << '\n';
+      std::cout << "Request done\n";
+    }
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
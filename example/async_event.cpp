@@ -0,0 +1,78 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async_event.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <atomic>
+#include <iostream>
+#include <vector>
+
+struct service {
+  mp_coro::async_manual_reset_event started;
+  mp_coro::async_auto_reset_event token;
+  mp_coro::single_consumer_event all_done;
+  std::atomic<int> processed = 0;
+  std::atomic<int> remaining = 0;
+};
+
+mp_coro::task<> worker(mp_coro::static_thread_pool& pool, service& s, int jobs)
+{
+  co_await pool.schedule();
+  co_await s.started;  // all of the workers wait for the startup without blocking any thread
+  for (int i = 0; i < jobs; ++i) {
+    co_await s.token;  // each `set()` releases exactly one worker
+    ++s.processed;
+    s.token.set();  // pass the token to the next worker
+  }
+  if (--s.remaining == 0) s.all_done.set();
+}
+
+mp_coro::task<> controller(mp_coro::static_thread_pool& pool, service& s)
+{
+  co_await pool.schedule();
+  s.started.set();
+  s.token.set();
+  co_await s.all_done;
+  std::cout << "Processed " << s.processed << " jobs\n";
+}
+
+int main()
+{
+  try {
+    constexpr int workers = 100;
+    constexpr int jobs_per_worker = 10;
+    mp_coro::static_thread_pool pool(4);
+    service s;
+    s.remaining = workers;
+
+    std::vector<mp_coro::task<>> tasks;
+    for (int i = 0; i < workers; ++i) tasks.push_back(worker(pool, s, jobs_per_worker));
+    tasks.push_back(controller(pool, s));
+    mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
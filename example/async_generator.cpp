@@ -0,0 +1,85 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async_generator.h>
+#include <mp-coro/io_context.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <span>
+
+// RAII owner of a file descriptor
+class file {
+  int fd_;
+public:
+  explicit file(int fd) : fd_(fd) {}
+  file(const file&) = delete;
+  file& operator=(const file&) = delete;
+  ~file() { ::close(fd_); }
+  int get() const { return fd_; }
+};
+
+// streams the file in chunks without materializing it in memory (the buffer is reused for each chunk)
+mp_coro::async_generator<std::span<const std::byte>> read_chunks(std::filesystem::path path)
+{
+  const file f(co_await mp_coro::async_open(path, O_RDONLY));
+  std::array<std::byte, 256> buffer;
+  std::uint64_t offset = 0;
+  while (const std::size_t bytes = co_await mp_coro::async_read(f.get(), buffer, offset)) {
+    offset += bytes;
+    co_yield std::span<const std::byte>(buffer.data(), bytes);
+  }
+}
+
+mp_coro::async_generator<int> count_lines(mp_coro::async_generator<std::span<const std::byte>> chunks)
+{
+  int lines = 0;
+  for (auto it = co_await chunks.begin(); it != chunks.end(); co_await ++it) {
+    lines += static_cast<int>(std::ranges::count(*it, std::byte{'\n'}));
+    co_yield lines;
+  }
+}
+
+mp_coro::task<> print_progress(const std::filesystem::path& path)
+{
+  auto lines = count_lines(read_chunks(path));
+  for (auto it = co_await lines.begin(); it != lines.end(); co_await ++it)
+    std::cout << "lines so far: " << *it << '\n';
+}
+
+int main()
+{
+  try {
+    mp_coro::sync_await(print_progress("/etc/passwd"));
+    mp_coro::sync_await(print_progress("/non-existent"));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
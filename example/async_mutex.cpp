@@ -0,0 +1,92 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async_mutex.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <iostream>
+#include <vector>
+
+struct account {
+  mp_coro::async_mutex mutex;
+  std::vector<int> history;
+  int balance = 0;
+};
+
+mp_coro::task<> deposit(mp_coro::static_thread_pool& pool, account& acc, int amount, int count)
+{
+  co_await pool.schedule();
+  for (int i = 0; i < count; ++i) {
+    // no thread is blocked while waiting for the lock
+    const auto lock = co_await acc.mutex.scoped_lock();
+    acc.balance += amount;
+    acc.history.push_back(acc.balance);
+  }
+}
+
+mp_coro::task<> increment(mp_coro::async_mutex& mutex, long& counter)
+{
+  co_await mutex.lock();
+  ++counter;
+  mutex.unlock();
+}
+
+mp_coro::task<> unlock(mp_coro::async_mutex& mutex)
+{
+  mutex.unlock();
+  co_return;
+}
+
+// all of the coroutines get queued on the locked mutex and each of them hands the lock over to the next one
+// on `unlock()` without growing the stack
+long deep_contention(int count)
+{
+  mp_coro::async_mutex mutex;
+  long counter = 0;
+  mp_coro::sync_await(mutex.lock());
+  std::vector<mp_coro::task<>> tasks;
+  for (int i = 0; i < count; ++i) tasks.push_back(increment(mutex, counter));
+  tasks.push_back(unlock(mutex));
+  mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+  return counter;
+}
+
+int main()
+{
+  try {
+    mp_coro::static_thread_pool pool(4);
+    account acc;
+
+    std::vector<mp_coro::task<>> tasks;
+    for (int i = 1; i <= 8; ++i) tasks.push_back(deposit(pool, acc, i, 1000));
+    mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+
+    std::cout << "Balance: " << acc.balance << " after " << acc.history.size() << " deposits\n";
+
+    std::cout << "Increments by queued waiters: " << deep_contention(1'000'000) << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
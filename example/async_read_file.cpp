@@ -20,14 +20,18 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+
+#include <mp-coro/buffer_pool.h>
+#include <mp-coro/io_context.h>
 #include <mp-coro/sync_await.h>
 #include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <cstddef>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
-#include <source_location>
 #include <syncstream>
 #include <thread>
+#include <vector>
 
 struct tid_t {
   friend std::ostream& operator<<(std::ostream& os, tid_t)
@@ -37,57 +41,62 @@ struct tid_t {
 };
 inline constexpr tid_t tid;
 
-std::jthread worker;
+// RAII owner of a file descriptor
+class file {
+  int fd_;
+public:
+  explicit file(int fd) : fd_(fd) {}
+  file(const file&) = delete;
+  file& operator=(const file&) = delete;
+  ~file() { ::close(fd_); }
+  int get() const { return fd_; }
+};
 
-mp_coro::task<std::string::size_type> async_read_file(const std::filesystem::path& path)
+// the file is read in chunks to a buffer leased from the pool
+mp_coro::task<std::size_t> async_read_file(mp_coro::buffer_pool& buffers, const std::filesystem::path& path)
 {
-  struct awaitable {
-    awaitable(const std::filesystem::path& path) : path_(path) {}
-    static bool await_ready() noexcept { return false; }
-    void await_suspend(std::coroutine_handle<> handle)
-    {
-      auto work = [handle, this] {
-        std::osyncstream(std::cout) << tid << " worker thread: opening file " << path_ << '\n';
-        auto stream = std::ifstream(path_);
-        std::osyncstream(std::cout) << tid << " worker thread: reading file\n";
-        result_.assign(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
-        std::osyncstream(std::cout) << tid << " worker thread: resuming coro\n";
-        handle.resume();
-        std::osyncstream(std::cout) << tid << " worker thread: exiting\n";
-      };
-      worker = std::jthread(work);  // TODO: Fix that (replace with a thread pool)
-    }
-    std::string await_resume() noexcept { return std::move(result_); }
-  private:
-    const std::filesystem::path& path_;
-    std::string result_;
-  };
-
-  std::osyncstream(std::cout) << tid << " readFile(): about to read file async\n";
-  const std::string result = co_await awaitable(path);
-  std::osyncstream(std::cout) << tid << " readFile(): about to return (size " << result.size() << ")\n";
-
-  co_return result.size();
+  std::osyncstream(std::cout) << tid << " async_read_file(): opening file " << path << '\n';
+  const file f(co_await mp_coro::async_open(path, O_RDONLY));
+  const mp_coro::buffer_lease buffer = co_await buffers.acquire();
+  std::osyncstream(std::cout) << tid << " async_read_file(): reading file to buffer #" << buffer.index() << '\n';
+  std::size_t size = 0;
+  while (const std::size_t bytes = co_await buffers.async_read(f.get(), buffer, size)) size += bytes;
+  std::osyncstream(std::cout) << tid << " async_read_file(): about to return (size " << size << ")\n";
+  co_return size;
 }
 
-void f1(const std::filesystem::path& path)
+void f1(mp_coro::buffer_pool& buffers, const std::filesystem::path& path)
 {
-  auto t = async_read_file(path);
+  auto t = async_read_file(buffers, path);
   std::osyncstream(std::cout) << "Result: " << sync_await(t) << '\n';
 }
 
-mp_coro::task<> f2(const std::filesystem::path& path)
+mp_coro::task<> f2(mp_coro::buffer_pool& buffers, const std::filesystem::path& path)
 {
-  auto t = async_read_file(path);
+  auto t = async_read_file(buffers, path);
   std::osyncstream(std::cout) << "Result: " << co_await t << '\n';
 }
 
+// many reads in flight on the single completion thread of the I/O context (waiting for the buffers in turns)
+mp_coro::task<> f3(mp_coro::buffer_pool& buffers, const std::filesystem::path& path)
+{
+  std::vector<mp_coro::task<std::size_t>> reads;
+  for (int i = 0; i < 3; ++i) reads.push_back(async_read_file(buffers, path));
+  std::size_t total = 0;
+  for (std::size_t size : co_await mp_coro::when_all(std::move(reads))) total += size;
+  std::osyncstream(std::cout) << "Total: " << total << '\n';
+}
+
 int main()
 {
   try {
+    std::cout << "io_uring: " << std::boolalpha << mp_coro::default_io_context().uses_io_uring() << '\n';
+    mp_coro::buffer_pool buffers(mp_coro::default_io_context(), 2, 64 * 1024);
+    std::cout << "registered buffers: " << buffers.registered() << '\n';
     auto path = "/etc/passwd";
-    f1(path);
-    sync_await(f2(path));
+    f1(buffers, path);
+    sync_await(f2(buffers, path));
+    sync_await(f3(buffers, path));
   } catch (const std::exception& ex) {
     std::osyncstream(std::cout) << "Unhandled exception: " << ex.what() << '\n';
   }
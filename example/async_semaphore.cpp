@@ -0,0 +1,101 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async_semaphore.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+inline constexpr int max_concurrent_calls = 3;
+
+struct backend {
+  mp_coro::async_semaphore limit{max_concurrent_calls};
+  std::atomic<int> in_flight = 0;
+  std::atomic<int> peak = 0;
+};
+
+mp_coro::task<int> call_backend(mp_coro::static_thread_pool& pool, backend& b, int request)
+{
+  co_await pool.schedule();
+  // at most `max_concurrent_calls` requests get past this point at the same time
+  const auto permit = co_await b.limit.scoped_acquire();
+  const int calls = ++b.in_flight;
+  int peak = b.peak.load();
+  while (calls > peak && !b.peak.compare_exchange_weak(peak, calls)) {}
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  --b.in_flight;
+  co_return request * 2;
+}
+
+mp_coro::task<> queued_call(mp_coro::async_semaphore& limit, long& calls)
+{
+  const auto permit = co_await limit.scoped_acquire();
+  ++calls;
+}
+
+mp_coro::task<> release(mp_coro::async_semaphore& limit, std::ptrdiff_t n)
+{
+  limit.release(n);
+  co_return;
+}
+
+// all of the coroutines get queued before any permit is available and each of them releases its permit
+// to the next waiter without growing the stack
+long deep_queue(int count)
+{
+  mp_coro::async_semaphore limit{0};
+  long calls = 0;
+  std::vector<mp_coro::task<>> tasks;
+  for (int i = 0; i < count; ++i) tasks.push_back(queued_call(limit, calls));
+  tasks.push_back(release(limit, max_concurrent_calls));
+  mp_coro::sync_await(mp_coro::when_all(std::move(tasks)));
+  return calls;
+}
+
+int main()
+{
+  try {
+    mp_coro::static_thread_pool pool(8);
+    backend b;
+
+    std::vector<mp_coro::task<int>> requests;
+    for (int i = 0; i < 20; ++i) requests.push_back(call_backend(pool, b, i));
+    const auto results = mp_coro::sync_await(mp_coro::when_all(std::move(requests)));
+
+    int sum = 0;
+    for (int r : results) sum += r;
+    std::cout << "Sum: " << sum << ", concurrent backend calls: " << b.peak << " (limit " << max_concurrent_calls
+              << ")\n";
+
+    std::cout << "Calls of queued requests: " << deep_queue(1'000'000) << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
@@ -0,0 +1,90 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async.h>
+#include <mp-coro/cancellation.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <chrono>
+#include <iostream>
+#include <stdexcept>
+#include <stop_token>
+#include <syncstream>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+// a long computation polling the stop token of the awaiting coroutine
+mp_coro::task<int> compute(mp_coro::static_thread_pool& pool, int id, int steps)
+{
+  co_return co_await mp_coro::async(pool, [=](std::stop_token token) {
+    for (int i = 0; i < steps; ++i) {
+      if (token.stop_requested()) {
+        std::osyncstream(std::cout) << "compute #" << id << ": stopped after " << i << " steps\n";
+        return -1;
+      }
+      std::this_thread::sleep_for(10ms);
+    }
+    std::osyncstream(std::cout) << "compute #" << id << ": done\n";
+    return id;
+  });
+}
+
+mp_coro::task<int> failing(mp_coro::static_thread_pool& pool)
+{
+  co_await mp_coro::async(pool, [] { std::this_thread::sleep_for(50ms); });
+  throw std::runtime_error("failing: invalid input");
+}
+
+mp_coro::task<bool> stopped()
+{
+  const std::stop_token token = co_await mp_coro::get_stop_token();
+  co_return token.stop_requested();
+}
+
+int main()
+{
+  mp_coro::static_thread_pool pool(3);
+
+  // the first failure stops the rest of the work
+  try {
+    const auto [a, b, c] =
+      mp_coro::sync_await(mp_coro::when_all(compute(pool, 1, 100), failing(pool), compute(pool, 2, 100)));
+    std::cout << a << ' ' << b << ' ' << c << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Exception: " << ex.what() << '\n';
+  }
+
+  // the stop requested by the caller is propagated through `when_all` and `async`
+  std::stop_source source;
+  std::jthread watchdog([&] {
+    std::this_thread::sleep_for(100ms);
+    source.request_stop();
+  });
+  const auto [a, b] =
+    mp_coro::sync_await(source.get_token(), mp_coro::when_all(compute(pool, 3, 100), compute(pool, 4, 5)));
+  std::cout << "Results: " << a << ' ' << b << '\n';
+  std::cout << "Stop requested: " << std::boolalpha << mp_coro::sync_await(source.get_token(), stopped()) << '\n';
+}
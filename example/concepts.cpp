@@ -24,6 +24,8 @@
 #include <mp-coro/concepts.h>
 #include <mp-coro/generator.h>
 #include <mp-coro/task.h>
+#include <cstddef>
+#include <memory>
 
 using namespace mp_coro;
 
@@ -81,6 +83,10 @@ static_assert(awaitable_of<task<void>&, void>);
 static_assert(awaitable_of<const task<void>&, void>);
 static_assert(awaitable_of<task<void>&&, void>);
 
+// task<int, Allocator>
+static_assert(awaitable_of<task<int, std::allocator<std::byte>>, int&&>);
+static_assert(awaitable_of<task<int, std::allocator<std::byte>>&, const int&>);
+
 // generator<int>
 static_assert(!awaitable<generator<int>>);
 static_assert(std::input_iterator<generator<int>::iterator>);
@@ -88,4 +94,8 @@ static_assert(std::ranges::input_range<generator<int>>);
 static_assert(std::ranges::viewable_range<generator<int>>);
 static_assert(std::ranges::view<generator<int>>);
 
+// generator<int, Allocator>
+static_assert(std::ranges::input_range<generator<int, std::allocator<std::byte>>>);
+static_assert(std::ranges::view<generator<int, std::allocator<std::byte>>>);
+
 int main() {}
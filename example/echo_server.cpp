@@ -0,0 +1,93 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/reactor.h>
+#include <mp-coro/socket.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <array>
+#include <cstddef>
+#include <filesystem>
+#include <iostream>
+#include <span>
+#include <string>
+#include <syncstream>
+#include <vector>
+
+mp_coro::task<> echo_session(mp_coro::async_socket socket)
+{
+  std::array<std::byte, 4096> buffer;
+  while (const std::size_t size = co_await socket.async_recv(buffer))
+    for (std::size_t sent = 0; sent < size;)
+      sent += co_await socket.async_send(std::span(buffer).subspan(sent, size - sent));
+}
+
+// accepts `clients` connections and serves all of them concurrently
+mp_coro::task<> echo_server(mp_coro::async_socket& listener, int clients)
+{
+  std::vector<mp_coro::task<>> sessions;
+  for (int i = 0; i < clients; ++i) sessions.push_back(echo_session(co_await listener.async_accept()));
+  co_await mp_coro::when_all(std::move(sessions));
+}
+
+mp_coro::task<> client(mp_coro::reactor& r, mp_coro::endpoint server, std::string message)
+{
+  auto socket = mp_coro::async_socket::open(r, server);
+  co_await socket.async_connect(server);
+  const auto request = std::as_bytes(std::span(message));
+  for (std::size_t sent = 0; sent < request.size();) sent += co_await socket.async_send(request.subspan(sent));
+  socket.shutdown_send();
+
+  std::string reply(message.size(), '\0');
+  const auto buffer = std::as_writable_bytes(std::span(reply));
+  std::size_t received = 0;
+  while (const std::size_t size = co_await socket.async_recv(buffer.subspan(received))) received += size;
+  std::osyncstream(std::cout) << "Reply: " << reply.substr(0, received) << '\n';
+}
+
+void run(mp_coro::reactor& r, const mp_coro::endpoint& local)
+{
+  auto listener = mp_coro::async_socket::listen(r, local);
+  const auto server = listener.local_endpoint();
+  mp_coro::sync_await(mp_coro::when_all(echo_server(listener, 3), client(r, server, "Hello"),
+                                        client(r, server, "from"), client(r, server, "mp-coro")));
+}
+
+int main()
+{
+  try {
+    mp_coro::reactor r;
+
+    std::cout << "TCP:\n";
+    run(r, mp_coro::endpoint::loopback(0));
+
+    std::cout << "Unix domain socket:\n";
+    const auto path = std::filesystem::temp_directory_path() / "mp_coro_echo_server.sock";
+    std::filesystem::remove(path);
+    run(r, mp_coro::endpoint::unix_domain(path.native()));
+    std::filesystem::remove(path);
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
@@ -20,11 +20,14 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 // SOFTWARE.
 
+#include <mp-coro/chunked_generator.h>
 #include <mp-coro/generator.h>
 #include <mp-coro/type_traits.h>
+#include <array>
 #include <cstdint>
 #include <iostream>
 #include <ranges>
+#include <span>
 #include <utility>
 #include <vector>
 
@@ -79,6 +82,29 @@ mp_coro::generator<std::tuple<std::ranges::range_reference_t<Rs>...>> zip(Rs&&..
   return zip_impl<Rs...>(std::index_sequence_for<Rs...>{}, std::forward<Rs>(ranges)...);
 }
 
+struct tree_node {
+  int value;
+  std::vector<tree_node> children;
+};
+
+// pre-order traversal with the elements of the subtrees yielded directly from the leaves
+mp_coro::generator<int> walk(const tree_node& node)
+{
+  co_yield node.value;
+  for (const auto& child : node.children) co_yield mp_coro::elements_of(walk(child));
+}
+
+// the coroutine is resumed once per 4 squares
+mp_coro::chunked_generator<int> squares(int count)
+{
+  std::array<int, 4> buffer;
+  for (int i = 0; i < count;) {
+    std::size_t size = 0;
+    for (; size < buffer.size() && i < count; ++size, ++i) buffer[size] = i * i;
+    co_yield std::span<const int>(buffer.data(), size);
+  }
+}
+
 mp_coro::generator<int> broken()
 {
   co_yield 1;
@@ -130,6 +156,17 @@ int main()
       std::cout << "[" << v1 << ", " << v2 << "] ";
     std::cout << '\n';
 
+    const tree_node tree{1, {{2, {{3, {}}, {4, {}}}}, {5, {{6, {}}}}}};
+    for (auto v : walk(tree)) std::cout << v << ' ';
+    std::cout << '\n';
+
+    for (auto v : squares(10)) std::cout << v << ' ';
+    std::cout << '\n';
+
+    auto chunked = squares(10);
+    for (std::span<const int> chunk : chunked.chunks()) std::cout << "[" << chunk.size() << " elements] ";
+    std::cout << '\n';
+
     for (auto v : broken()) std::cout << v << ' ';
     std::cout << '\n';
   } catch (const std::exception& ex) {
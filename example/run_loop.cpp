@@ -0,0 +1,62 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/run_loop.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <iostream>
+#include <string>
+#include <syncstream>
+#include <thread>
+
+mp_coro::task<int> handler(mp_coro::run_loop& loop, int id)
+{
+  co_await loop.schedule();
+  std::osyncstream(std::cout) << "handler #" << id << " (tid=" << std::this_thread::get_id() << ")\n";
+  co_return id * 10;
+}
+
+// offloads the work to the pool and comes back to the loop
+mp_coro::task<int> offload(mp_coro::run_loop& loop, mp_coro::static_thread_pool& pool)
+{
+  co_await pool.schedule();
+  std::osyncstream(std::cout) << "offload on the pool (tid=" << std::this_thread::get_id() << ")\n";
+  co_await loop.schedule();
+  std::osyncstream(std::cout) << "offload back on the loop (tid=" << std::this_thread::get_id() << ")\n";
+  co_return 42;
+}
+
+int main()
+{
+  try {
+    std::cout << "main (tid=" << std::this_thread::get_id() << ")\n";
+    mp_coro::run_loop loop;
+    mp_coro::static_thread_pool pool(1);
+    const auto [a, b, c] =
+      mp_coro::sync_await(loop, mp_coro::when_all(handler(loop, 1), handler(loop, 2), offload(loop, pool)));
+    std::cout << "Results: " << a << ' ' << b << ' ' << c << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
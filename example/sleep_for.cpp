@@ -22,35 +22,27 @@
 
 #include <mp-coro/sync_await.h>
 #include <mp-coro/task.h>
-#include <mp-coro/type_traits.h>
+#include <mp-coro/timer_service.h>
+#include <mp-coro/when_all.h>
 #include <chrono>
 #include <iostream>
-#include <thread>
+#include <syncstream>
 
-template<mp_coro::specialization_of<std::chrono::duration> D>
-struct sleep_for {
-  D duration;
-  bool await_ready() const noexcept { return duration <= D::zero(); }
-  std::coroutine_handle<> await_suspend(std::coroutine_handle<> coro) const
-  {
-    std::this_thread::sleep_for(duration);
-    return coro;
-  }
-  static void await_resume() noexcept {}
-};
+using namespace std::chrono_literals;
 
-mp_coro::task<> sleepy()
+mp_coro::task<> sleepy(int id, std::chrono::milliseconds duration)
 {
-  using namespace std::chrono_literals;
-  std::cout << "sleepy(): about to sleep\n";
-  co_await sleep_for{1s};
-  std::cout << "sleepy(): about to return\n";
+  std::osyncstream(std::cout) << "sleepy(" << id << "): about to sleep\n";
+  // no thread is blocked while the coroutine sleeps
+  co_await mp_coro::sleep_for(duration);
+  std::osyncstream(std::cout) << "sleepy(" << id << "): about to return\n";
 }
 
 int main()
 {
   try {
-    mp_coro::sync_await(sleepy());
+    mp_coro::sync_await(sleepy(0, 1s));
+    mp_coro::sync_await(mp_coro::when_all(sleepy(1, 300ms), sleepy(2, 100ms), sleepy(3, 200ms)));
   } catch (const std::exception& ex) {
     std::cout << "Unhandled exception: " << ex.what() << '\n';
   }
@@ -0,0 +1,68 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_all.h>
+#include <iostream>
+#include <syncstream>
+#include <thread>
+
+struct tid_t {
+  friend std::ostream& operator<<(std::ostream& os, tid_t)
+  {
+    return os << "(tid=" << std::this_thread::get_id() << ')';
+  }
+};
+inline constexpr tid_t tid;
+
+mp_coro::task<int> compute(mp_coro::static_thread_pool& pool, int i)
+{
+  std::osyncstream(std::cout) << tid << " compute(" << i << "): about to schedule\n";
+  co_await pool.schedule();
+  std::osyncstream(std::cout) << tid << " compute(" << i << "): running on the pool\n";
+  co_return i * i;
+}
+
+int main()
+{
+  try {
+    mp_coro::static_thread_pool pool(4);
+    std::osyncstream(std::cout) << tid << " main(): pool of " << pool.thread_count() << " threads\n";
+
+    const auto [v1, v2, v3, v4] =
+      mp_coro::sync_await(mp_coro::when_all(compute(pool, 1), compute(pool, 2), compute(pool, 3), compute(pool, 4)));
+    std::cout << "Sum of squares: " << v1 + v2 + v3 + v4 << '\n';
+
+    // the pool can be selected for each `async` invocation
+    const int res = mp_coro::sync_await(mp_coro::async(pool, [] {
+      std::osyncstream(std::cout) << tid << " async: running on the pool\n";
+      return 42;
+    }));
+    std::cout << "Result: " << res << '\n';
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
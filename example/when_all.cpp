@@ -24,7 +24,9 @@
 #include <mp-coro/sync_await.h>
 #include <mp-coro/task.h>
 #include <mp-coro/when_all.h>
+#include <array>
 #include <iostream>
+#include <span>
 #include <syncstream>
 #include <thread>
 
@@ -71,6 +73,13 @@ struct lifetime {
   void operator()() const { std::cout << "[lifetime] " << txt << '\n'; }
 };
 
+mp_coro::task<int> delayed(int i)
+{
+  using namespace std::chrono_literals;
+  co_await mp_coro::async([] { sleep_for(1s); });
+  co_return i;
+}
+
 int main()
 {
   using namespace mp_coro;
@@ -120,6 +129,23 @@ int main()
       auto a = when_all(v);
       sync_await(a);
     }
+
+    {
+      std::vector<task<int>> v;
+      for (int i = 0; i < 6; ++i) v.push_back(delayed(i));
+      const auto results = sync_await(when_all_n(std::move(v), 2));
+      for (int r : results) std::cout << r << ' ';
+      std::cout << '\n';
+    }
+
+    {
+      std::vector<task<int>> v;
+      for (int i = 0; i < 3; ++i) v.push_back(delayed(i));
+      std::array<int, 3> results;
+      sync_await(when_all(std::move(v), std::span(results)));
+      for (int r : results) std::cout << r << ' ';
+      std::cout << '\n';
+    }
   } catch (const std::exception& ex) {
     std::cout << "Unhandled exception: " << ex.what() << '\n';
   }
@@ -0,0 +1,65 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/when_any.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <syncstream>
+#include <thread>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+mp_coro::task<std::string> replica(mp_coro::static_thread_pool& pool, std::string name,
+                                   std::chrono::milliseconds latency)
+{
+  co_await pool.schedule();
+  std::this_thread::sleep_for(latency);
+  std::osyncstream(std::cout) << name << ": done\n";
+  co_return name;
+}
+
+int main()
+{
+  try {
+    mp_coro::static_thread_pool pool(3);
+
+    // hedged request - the fastest replica wins and the others are released when they finish
+    const auto winner = mp_coro::sync_await(mp_coro::when_any(replica(pool, "replica #1", 300ms),
+                                                              replica(pool, "replica #2", 100ms),
+                                                              replica(pool, "replica #3", 200ms)));
+    std::cout << "Winner: " << winner.index() << " (" << std::visit([](const auto& v) { return v; }, winner) << ")\n";
+
+    std::vector<mp_coro::task<std::string>> tasks;
+    for (int i = 0; i < 3; ++i)
+      tasks.push_back(replica(pool, "task #" + std::to_string(i), std::chrono::milliseconds(50 * (3 - i))));
+    const auto [index, value] = mp_coro::sync_await(mp_coro::when_any(std::move(tasks)));
+    std::cout << "Winner: " << index << " (" << value << ")\n";
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
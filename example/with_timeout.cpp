@@ -0,0 +1,85 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#include <mp-coro/async.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/sync_await.h>
+#include <mp-coro/task.h>
+#include <mp-coro/timer_service.h>
+#include <mp-coro/with_timeout.h>
+#include <chrono>
+#include <iostream>
+#include <stop_token>
+#include <syncstream>
+#include <system_error>
+#include <thread>
+
+using namespace std::chrono_literals;
+
+mp_coro::task<int> fetch(int id, std::chrono::milliseconds latency)
+{
+  co_await mp_coro::sleep_for(latency);
+  co_return id;
+}
+
+// a blocking computation that gives up as soon as the stop is requested
+mp_coro::task<int> compute(mp_coro::static_thread_pool& pool)
+{
+  co_return co_await mp_coro::async(pool, [](std::stop_token token) {
+    int steps = 0;
+    while (!token.stop_requested()) {
+      std::this_thread::sleep_for(10ms);
+      ++steps;
+    }
+    std::osyncstream(std::cout) << "compute: stopped after " << steps << " steps\n";
+    return steps;
+  });
+}
+
+mp_coro::task<> run(mp_coro::static_thread_pool& pool)
+{
+  std::cout << "fetch #1: " << co_await mp_coro::with_timeout(fetch(1, 10ms), 50ms) << '\n';
+  try {
+    const int id = co_await mp_coro::with_timeout(fetch(2, 1h), 50ms);
+    std::cout << "fetch #2: " << id << '\n';
+  } catch (const std::system_error& ex) {
+    std::cout << "fetch #2: " << ex.what() << '\n';
+  }
+  try {
+    const auto deadline = mp_coro::timer_service::clock::now() + 100ms;
+    const int steps = co_await mp_coro::with_deadline(compute(pool), deadline);
+    std::cout << "compute: " << steps << '\n';
+  } catch (const std::system_error& ex) {
+    std::cout << "compute: " << ex.what() << '\n';
+  }
+}
+
+int main()
+{
+  try {
+    mp_coro::static_thread_pool pool(1);
+    mp_coro::sync_await(run(pool));
+  } catch (const std::exception& ex) {
+    std::cout << "Unhandled exception: " << ex.what() << '\n';
+  }
+}
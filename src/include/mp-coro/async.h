@@ -23,20 +23,42 @@
 #pragma once
 
 #include <mp-coro/bits/storage.h>
+#include <mp-coro/static_thread_pool.h>
 #include <mp-coro/trace.h>
 #include <concepts>
 #include <coroutine>
-#include <thread>
+#include <stop_token>
+#include <type_traits>
 
 namespace mp_coro {
 
-template<std::invocable Func>
+namespace detail {
+
+template<typename F>
+concept async_invocable = std::invocable<F> || std::invocable<F, std::stop_token>;
+
+template<typename F>
+struct async_result : std::invoke_result<F> {};
+
+template<typename F>
+  requires std::invocable<F, std::stop_token>
+struct async_result<F> : std::invoke_result<F, std::stop_token> {};
+
+}  // namespace detail
+
+// Runs `Func` on a thread pool. A callable taking `std::stop_token` gets the stop token of the awaiting coroutine.
+template<detail::async_invocable Func>
 class async {
 public:
-  using return_type = std::invoke_result_t<Func>;
+  using return_type = typename detail::async_result<Func>::type;
 
   template<std::convertible_to<Func> F>
-  explicit async(F&& func) : func_{std::forward<F>(func)}
+  explicit async(F&& func) : async(default_thread_pool(), std::forward<F>(func))
+  {
+  }
+
+  template<std::convertible_to<Func> F>
+  async(static_thread_pool& pool, F&& func) : pool_(&pool), func_{std::forward<F>(func)}
   {
   }
 
@@ -52,36 +74,44 @@ public:
       }
       void await_suspend(std::coroutine_handle<> handle)
       {
-        auto work = [&, handle]() {
-          TRACE_FUNC();
-          try {
-            if constexpr (std::is_void_v<return_type>)
-              awaitable.func_();
-            else
-              awaitable.result_.set_value(awaitable.func_());
-          } catch (...) {
-            awaitable.result_.set_exception(std::current_exception());
-          }
-          handle.resume();
-        };
-
         TRACE_FUNC();
-        std::jthread(work).detach();  // TODO: Fix that (replace with a thread pool)
+        awaitable.pool_->enqueue(handle);
       }
       decltype(auto) await_resume()
       {
         TRACE_FUNC();
-        return std::move(awaitable.result_).get();
+        // the coroutine is resumed on one of the pool's threads so the work is done in place
+        if constexpr (std::is_void_v<return_type>)
+          awaitable.invoke();
+        else {
+          awaitable.result_.set_value(awaitable.invoke());
+          return std::move(awaitable.result_).get();
+        }
       }
     };
     return awaiter{*this};
   }
 private:
+  static_thread_pool* pool_;
   Func func_;
+  std::stop_token stop_token_;
   detail::storage<return_type> result_;
+
+  friend void inherit_stop_token(async& a, const std::stop_token& token) noexcept { a.stop_token_ = token; }
+
+  decltype(auto) invoke()
+  {
+    if constexpr (std::invocable<Func, std::stop_token>)
+      return func_(std::move(stop_token_));
+    else
+      return func_();
+  }
 };
 
-template<std::invocable F>
+template<detail::async_invocable F>
 async(F) -> async<F>;
 
+template<detail::async_invocable F>
+async(static_thread_pool&, F) -> async<F>;
+
 }  // namespace mp_coro
@@ -0,0 +1,286 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/bounded_mpmc_queue.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/trace.h>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace mp_coro {
+
+// A bounded multi-producer/multi-consumer channel between coroutines.
+//
+// `co_await ch.send(value)` suspends when the channel is full and `co_await ch.receive()` when it is empty.
+// The values go through a lock-free ring buffer, so as long as there is no backpressure no lock is taken.
+// Suspended senders and receivers wait in intrusive FIFO lists (stored in their awaiters) guarded by a mutex;
+// they are resumed with the operation already completed on the thread of the counterpart that made it
+// possible.
+//
+// After `close()` sending fails and receiving drains the values left in the channel.
+template<typename T>
+class async_channel : private detail::noncopyable {
+  static_assert(std::is_nothrow_move_constructible_v<T>);
+public:
+  class [[nodiscard]] send_awaitable {
+  public:
+    send_awaitable(async_channel& channel, T value) noexcept : channel_(channel), value_(std::move(value)) {}
+
+    bool await_ready() noexcept
+    {
+      TRACE_FUNC();
+      if (channel_.closed_.load(std::memory_order_relaxed)) return true;
+      sent_ = channel_.try_send_impl(value_);
+      return sent_;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      handle_ = handle;
+      return channel_.enqueue(*this);
+    }
+
+    // Returns false if the channel was closed before the value was sent
+    bool await_resume() const noexcept
+    {
+      TRACE_FUNC();
+      return sent_;
+    }
+
+  private:
+    friend class async_channel;
+
+    async_channel& channel_;
+    T value_;
+    bool sent_ = false;
+    std::coroutine_handle<> handle_;
+    send_awaitable* next_ = nullptr;
+  };
+
+  class [[nodiscard]] receive_awaitable {
+  public:
+    explicit receive_awaitable(async_channel& channel) noexcept : channel_(channel) {}
+
+    bool await_ready() noexcept
+    {
+      TRACE_FUNC();
+      result_ = channel_.try_receive();
+      if (result_) return true;
+      if (!channel_.closed_.load(std::memory_order_acquire)) return false;
+      result_ = channel_.try_receive();  // a value sent before closing may have arrived in the meantime
+      return true;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      handle_ = handle;
+      return channel_.enqueue(*this);
+    }
+
+    // Returns `std::nullopt` if the channel is closed and empty
+    std::optional<T> await_resume() noexcept
+    {
+      TRACE_FUNC();
+      return std::move(result_);
+    }
+
+  private:
+    friend class async_channel;
+
+    async_channel& channel_;
+    std::optional<T> result_;
+    std::coroutine_handle<> handle_;
+    receive_awaitable* next_ = nullptr;
+  };
+
+  // `capacity` is rounded up to a power of two (at least 2)
+  explicit async_channel(std::size_t capacity) : queue_(capacity) {}
+
+  ~async_channel()
+  {
+    assert(!senders_.head && !receivers_.head && "the channel is destroyed with suspended waiters");
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return queue_.capacity(); }
+  [[nodiscard]] bool closed() const noexcept { return closed_.load(std::memory_order_acquire); }
+
+  [[nodiscard]] send_awaitable send(T value) noexcept { return send_awaitable(*this, std::move(value)); }
+  [[nodiscard]] receive_awaitable receive() noexcept { return receive_awaitable(*this); }
+
+  // Returns false if the channel is full or closed
+  bool try_send(T& value)
+  {
+    if (closed_.load(std::memory_order_relaxed)) return false;
+    return try_send_impl(value);
+  }
+
+  [[nodiscard]] std::optional<T> try_receive()
+  {
+    std::optional<T> result = queue_.try_pop();
+    if (result && senders_waiting_.load(std::memory_order_seq_cst) > 0) resume_waiters();
+    return result;
+  }
+
+  // Fails all of the suspended senders and resumes the suspended receivers (with `std::nullopt` if there is
+  // nothing left in the channel)
+  void close()
+  {
+    TRACE_FUNC();
+    send_awaitable* senders = nullptr;
+    receive_awaitable* receivers = nullptr;
+    {
+      std::lock_guard lock(mutex_);
+      closed_.store(true, std::memory_order_release);
+      senders = std::exchange(senders_.head, nullptr);
+      senders_.tail = nullptr;
+      senders_waiting_.store(0, std::memory_order_relaxed);
+      receivers = std::exchange(receivers_.head, nullptr);
+      receivers_.tail = nullptr;
+      receivers_waiting_.store(0, std::memory_order_relaxed);
+      for (receive_awaitable* r = receivers; r; r = r->next_) r->result_ = queue_.try_pop();
+    }
+    while (senders) std::exchange(senders, senders->next_)->handle_.resume();
+    while (receivers) std::exchange(receivers, receivers->next_)->handle_.resume();
+  }
+
+private:
+  template<typename Waiter>
+  struct fifo {
+    Waiter* head = nullptr;
+    Waiter* tail = nullptr;
+
+    void push(Waiter& waiter) noexcept
+    {
+      if (tail)
+        tail->next_ = &waiter;
+      else
+        head = &waiter;
+      tail = &waiter;
+    }
+
+    Waiter* pop() noexcept
+    {
+      Waiter* waiter = std::exchange(head, head->next_);
+      if (!head) tail = nullptr;
+      return waiter;
+    }
+  };
+
+  detail::bounded_mpmc_queue<T> queue_;
+  std::atomic<bool> closed_ = false;
+  // the counters of the suspended waiters let the fast path skip the lock
+  std::atomic<std::size_t> senders_waiting_ = 0;
+  std::atomic<std::size_t> receivers_waiting_ = 0;
+  std::mutex mutex_;
+  fifo<send_awaitable> senders_;
+  fifo<receive_awaitable> receivers_;
+
+  bool try_send_impl(T& value)
+  {
+    if (!queue_.try_push(value)) return false;
+    if (receivers_waiting_.load(std::memory_order_seq_cst) > 0) resume_waiters();
+    return true;
+  }
+
+  // Both `enqueue()` overloads announce the waiter before retrying the operation, so either the retry succeeds
+  // or the counterpart completing its operation afterwards sees the waiter (all of the accesses are seq_cst).
+  // They return false if the operation completed and the coroutine should not be suspended.
+  bool enqueue(send_awaitable& sender)
+  {
+    {
+      std::lock_guard lock(mutex_);
+      senders_waiting_.fetch_add(1, std::memory_order_seq_cst);
+      if (!closed_.load(std::memory_order_relaxed) && !queue_.try_push(sender.value_)) {
+        senders_.push(sender);
+        return true;
+      }
+      sender.sent_ = !closed_.load(std::memory_order_relaxed);
+      senders_waiting_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (sender.sent_ && receivers_waiting_.load(std::memory_order_seq_cst) > 0) resume_waiters();
+    return false;
+  }
+
+  bool enqueue(receive_awaitable& receiver)
+  {
+    {
+      std::lock_guard lock(mutex_);
+      receivers_waiting_.fetch_add(1, std::memory_order_seq_cst);
+      receiver.result_ = queue_.try_pop();
+      if (!receiver.result_ && !closed_.load(std::memory_order_relaxed)) {
+        receivers_.push(receiver);
+        return true;
+      }
+      receivers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (receiver.result_ && senders_waiting_.load(std::memory_order_seq_cst) > 0) resume_waiters();
+    return false;
+  }
+
+  // Sends the values of the suspended senders and receives the values for the suspended receivers as long as
+  // possible. A value published to the queue may be hidden from the previous calls by a claimed but not yet
+  // published cell before it, so one call has to satisfy every waiter it can rather than just the first one.
+  void resume_waiters()
+  {
+    fifo<send_awaitable> senders;
+    fifo<receive_awaitable> receivers;
+    {
+      std::lock_guard lock(mutex_);
+      for (bool progress = true; progress;) {
+        progress = false;
+        while (senders_.head && queue_.try_push(senders_.head->value_)) {
+          send_awaitable& sender = *senders_.pop();
+          sender.sent_ = true;
+          sender.next_ = nullptr;
+          senders.push(sender);
+          senders_waiting_.fetch_sub(1, std::memory_order_relaxed);
+          progress = true;
+        }
+        while (receivers_.head) {
+          std::optional<T> value = queue_.try_pop();
+          if (!value) break;
+          receive_awaitable& receiver = *receivers_.pop();
+          receiver.result_ = std::move(value);
+          receiver.next_ = nullptr;
+          receivers.push(receiver);
+          receivers_waiting_.fetch_sub(1, std::memory_order_relaxed);
+          progress = true;
+        }
+      }
+    }
+    while (senders.head) senders.pop()->handle_.resume();
+    while (receivers.head) receivers.pop()->handle_.resume();
+  }
+};
+
+}  // namespace mp_coro
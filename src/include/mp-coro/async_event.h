@@ -0,0 +1,270 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/trace.h>
+#include <atomic>
+#include <coroutine>
+#include <mutex>
+
+namespace mp_coro {
+
+// An event awaited by at most one coroutine at a time.
+//
+// The state is a single atomic word: "not set", "set", or the address of the suspended coroutine.
+class single_consumer_event : private detail::noncopyable {
+public:
+  class [[nodiscard]] awaiter {
+  public:
+    explicit awaiter(single_consumer_event& event) noexcept : event_(event) {}
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return event_.is_set();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+      TRACE_FUNC();
+      void* expected = nullptr;
+      return event_.state_.compare_exchange_strong(expected, handle.address(), std::memory_order_release,
+                                                   std::memory_order_acquire);
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  private:
+    single_consumer_event& event_;
+  };
+
+  explicit single_consumer_event(bool initially_set = false) noexcept : state_(initially_set ? set_marker() : nullptr)
+  {
+  }
+
+  [[nodiscard]] bool is_set() const noexcept { return state_.load(std::memory_order_acquire) == set_marker(); }
+
+  // Resumes the waiting coroutine (if any) on the calling thread
+  void set()
+  {
+    TRACE_FUNC();
+    void* old = state_.exchange(set_marker(), std::memory_order_acq_rel);
+    if (old != nullptr && old != set_marker()) std::coroutine_handle<>::from_address(old).resume();
+  }
+
+  void reset() noexcept
+  {
+    void* expected = set_marker();
+    state_.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+  }
+
+  awaiter operator co_await() noexcept { return awaiter(*this); }
+
+private:
+  std::atomic<void*> state_;
+
+  const void* set_marker() const noexcept { return this; }
+  void* set_marker() noexcept { return this; }
+};
+
+// An event that stays set until it is explicitly reset. All of the waiting coroutines are resumed when
+// the event gets set.
+//
+// The state is a single atomic word: "set", "not set", or the top of the stack of the waiters (intrusive
+// nodes stored in the awaiters) so any number of coroutines may wait without allocation or locks.
+class async_manual_reset_event : private detail::noncopyable {
+public:
+  class [[nodiscard]] awaiter {
+  public:
+    explicit awaiter(async_manual_reset_event& event) noexcept : event_(event) {}
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return event_.is_set();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+      TRACE_FUNC();
+      handle_ = handle;
+      void* old = event_.state_.load(std::memory_order_acquire);
+      do {
+        if (old == event_.set_marker()) return false;
+        next_ = static_cast<awaiter*>(old);
+      } while (!event_.state_.compare_exchange_weak(old, this, std::memory_order_release, std::memory_order_acquire));
+      return true;
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  private:
+    friend class async_manual_reset_event;
+
+    async_manual_reset_event& event_;
+    std::coroutine_handle<> handle_;
+    awaiter* next_ = nullptr;
+  };
+
+  explicit async_manual_reset_event(bool initially_set = false) noexcept :
+      state_(initially_set ? set_marker() : nullptr)
+  {
+  }
+
+  [[nodiscard]] bool is_set() const noexcept { return state_.load(std::memory_order_acquire) == set_marker(); }
+
+  // Resumes all of the waiting coroutines on the calling thread (in no particular order)
+  void set()
+  {
+    TRACE_FUNC();
+    void* old = state_.exchange(set_marker(), std::memory_order_acq_rel);
+    if (old == set_marker()) return;
+    auto* waiter = static_cast<awaiter*>(old);
+    while (waiter) {
+      awaiter* next = waiter->next_;
+      waiter->handle_.resume();
+      waiter = next;
+    }
+  }
+
+  void reset() noexcept
+  {
+    void* expected = set_marker();
+    state_.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+  }
+
+  awaiter operator co_await() noexcept { return awaiter(*this); }
+
+private:
+  std::atomic<void*> state_;
+
+  const void* set_marker() const noexcept { return this; }
+  void* set_marker() noexcept { return this; }
+};
+
+// An event that releases exactly one waiting coroutine per `set()`. If no coroutine waits the event stays set
+// and the next awaiting coroutine resets it and continues without suspension.
+//
+// The state is a single atomic word: "set", "not set", or the top of the stack of newly suspended waiters
+// (intrusive nodes stored in the awaiters) so waiting is lock-free. Concurrent `set()` calls are serialized
+// with a mutex that also guards the FIFO of the waiters already taken from the stack.
+class async_auto_reset_event : private detail::noncopyable {
+public:
+  class [[nodiscard]] awaiter {
+  public:
+    explicit awaiter(async_auto_reset_event& event) noexcept : event_(event) {}
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return event_.try_consume();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+      TRACE_FUNC();
+      handle_ = handle;
+      void* old = event_.state_.load(std::memory_order_acquire);
+      while (true) {
+        if (old == event_.set_marker()) {
+          if (event_.state_.compare_exchange_weak(old, nullptr, std::memory_order_acquire,
+                                                  std::memory_order_acquire))
+            return false;
+        } else {
+          next_ = static_cast<awaiter*>(old);
+          if (event_.state_.compare_exchange_weak(old, this, std::memory_order_release, std::memory_order_acquire))
+            return true;
+        }
+      }
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  private:
+    friend class async_auto_reset_event;
+
+    async_auto_reset_event& event_;
+    std::coroutine_handle<> handle_;
+    awaiter* next_ = nullptr;
+  };
+
+  explicit async_auto_reset_event(bool initially_set = false) noexcept : state_(initially_set ? set_marker() : nullptr)
+  {
+  }
+
+  [[nodiscard]] bool is_set() const noexcept { return state_.load(std::memory_order_acquire) == set_marker(); }
+
+  // Resumes the longest waiting coroutine on the calling thread or sets the event if no one waits
+  void set()
+  {
+    TRACE_FUNC();
+    awaiter* waiter = nullptr;
+    {
+      std::lock_guard lock(mutex_);
+      if (!waiters_) {
+        void* old = state_.load(std::memory_order_relaxed);
+        while (old == nullptr)
+          if (state_.compare_exchange_weak(old, set_marker(), std::memory_order_release, std::memory_order_relaxed))
+            return;
+        if (old == set_marker()) return;
+        // take all of the new waiters and reverse them to the FIFO order
+        auto* stack = static_cast<awaiter*>(state_.exchange(nullptr, std::memory_order_acquire));
+        while (stack) {
+          awaiter* next = stack->next_;
+          stack->next_ = waiters_;
+          waiters_ = stack;
+          stack = next;
+        }
+      }
+      waiter = waiters_;
+      waiters_ = waiter->next_;
+    }
+    waiter->handle_.resume();
+  }
+
+  void reset() noexcept
+  {
+    void* expected = set_marker();
+    state_.compare_exchange_strong(expected, nullptr, std::memory_order_relaxed);
+  }
+
+  awaiter operator co_await() noexcept { return awaiter(*this); }
+
+private:
+  std::atomic<void*> state_;
+  std::mutex mutex_;
+  awaiter* waiters_ = nullptr;  // FIFO of the waiters already taken from the stack
+
+  const void* set_marker() const noexcept { return this; }
+  void* set_marker() noexcept { return this; }
+
+  bool try_consume() noexcept
+  {
+    void* expected = set_marker();
+    return state_.compare_exchange_strong(expected, nullptr, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+};
+
+}  // namespace mp_coro
@@ -0,0 +1,215 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/promise_allocator.h>
+#include <mp-coro/coro_ptr.h>
+#include <mp-coro/trace.h>
+#include <cassert>
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace mp_coro {
+
+// A lazy generator which body may `co_await` other awaitables.
+//
+// The consumer obtains the iterator with `co_await gen.begin()` and advances it with `co_await ++it`.
+// Both transfer the control to the generator coroutine and `co_yield` (or the end of the body) transfers it
+// back to the consumer (symmetric transfer), so each element costs two resumptions and no allocation:
+//
+// for (auto it = co_await gen.begin(); it != gen.end(); co_await ++it) use(*it);
+//
+// If the generator suspends on some other awaitable it is resumed by it (i.e. on an I/O thread) and so is
+// the consumer afterwards.
+template<typename T, typename Allocator = void>
+class [[nodiscard]] async_generator {
+public:
+  using value_type = std::remove_reference_t<T>;
+  using reference = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
+  using pointer = std::add_pointer_t<reference>;
+
+  struct promise_type : private detail::noncopyable, detail::promise_allocator<Allocator> {
+    pointer value = nullptr;
+    std::exception_ptr exception;
+    std::coroutine_handle<> consumer;
+
+    // transfers the control back to the consumer
+    struct yield_awaiter {
+      static bool await_ready() noexcept { return false; }
+      static std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+      {
+        TRACE_FUNC();
+        return handle.promise().consumer;
+      }
+      static void await_resume() noexcept {}
+    };
+
+    static std::suspend_always initial_suspend() noexcept
+    {
+      TRACE_FUNC();
+      return {};
+    }
+    static yield_awaiter final_suspend() noexcept
+    {
+      TRACE_FUNC();
+      return {};
+    }
+    static void return_void() noexcept { TRACE_FUNC(); }
+
+    async_generator get_return_object() noexcept
+    {
+      TRACE_FUNC();
+      return this;
+    }
+    yield_awaiter yield_value(reference v) noexcept
+    {
+      TRACE_FUNC();
+      value = std::addressof(v);
+      return {};
+    }
+    // the consumer may be resumed from another thread so the exception is rethrown by its awaiter
+    void unhandled_exception() noexcept
+    {
+      TRACE_FUNC();
+      exception = std::current_exception();
+    }
+  };
+
+  class iterator;
+
+  // resumes the generator until the next element
+  class [[nodiscard]] advance_awaitable {
+  public:
+    explicit advance_awaitable(std::coroutine_handle<promise_type> handle) noexcept : handle_(handle) {}
+
+    static bool await_ready() noexcept
+    {
+      TRACE_FUNC();
+      return false;
+    }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> consumer) noexcept
+    {
+      TRACE_FUNC();
+      handle_.promise().consumer = consumer;
+      return handle_;
+    }
+
+  protected:
+    std::coroutine_handle<promise_type> handle_;
+
+    void rethrow_if_failed() const
+    {
+      if (handle_.promise().exception) std::rethrow_exception(std::exchange(handle_.promise().exception, {}));
+    }
+  };
+
+  class iterator {
+  public:
+    using value_type = async_generator::value_type;
+    using difference_type = std::ptrdiff_t;
+
+    iterator(iterator&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    iterator& operator=(iterator&& other) noexcept
+    {
+      handle_ = std::exchange(other.handle_, {});
+      return *this;
+    }
+
+    [[nodiscard]] auto operator++() noexcept
+    {
+      TRACE_FUNC();
+      assert(!handle_.done() && "Can't increment async_generator end iterator");
+      struct awaitable : advance_awaitable {
+        iterator& it;
+        explicit awaitable(iterator& i) noexcept : advance_awaitable(i.handle_), it(i) {}
+        iterator& await_resume() const
+        {
+          TRACE_FUNC();
+          this->rethrow_if_failed();
+          return it;
+        }
+      };
+      return awaitable(*this);
+    }
+
+    [[nodiscard]] reference operator*() const noexcept
+    {
+      TRACE_FUNC();
+      assert(!handle_.done() && "Can't dereference async_generator end iterator");
+      return *handle_.promise().value;
+    }
+    [[nodiscard]] pointer operator->() const noexcept
+    {
+      TRACE_FUNC();
+      return std::addressof(operator*());
+    }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept
+    {
+      TRACE_FUNC();
+      return !handle_ || handle_.done();
+    }
+
+  private:
+    friend async_generator;
+
+    std::coroutine_handle<promise_type> handle_;
+
+    explicit iterator(std::coroutine_handle<promise_type> h) noexcept : handle_(h) {}
+  };
+
+  // Pre: Coroutine is suspended at its initial suspend point
+  [[nodiscard]] auto begin() noexcept
+  {
+    TRACE_FUNC();
+    assert(promise_ && "Can't call begin on moved-from async_generator");
+    struct awaitable : advance_awaitable {
+      using advance_awaitable::advance_awaitable;
+      iterator await_resume() const
+      {
+        TRACE_FUNC();
+        this->rethrow_if_failed();
+        return iterator(this->handle_);
+      }
+    };
+    return awaitable(std::coroutine_handle<promise_type>::from_promise(*promise_));
+  }
+  [[nodiscard]] std::default_sentinel_t end() const noexcept
+  {
+    TRACE_FUNC();
+    return std::default_sentinel;
+  }
+
+private:
+  promise_ptr<promise_type> promise_;
+  async_generator(promise_type* promise) : promise_(promise) {}
+};
+
+}  // namespace mp_coro
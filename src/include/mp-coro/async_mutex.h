@@ -0,0 +1,177 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/trampoline.h>
+#include <mp-coro/trace.h>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <utility>
+
+namespace mp_coro {
+
+class async_mutex;
+
+// Unlocks the owned `async_mutex` when destroyed
+class [[nodiscard]] async_mutex_lock {
+public:
+  explicit async_mutex_lock(async_mutex& mutex, std::adopt_lock_t) noexcept : mutex_(&mutex) {}
+  async_mutex_lock(async_mutex_lock&& other) noexcept : mutex_(std::exchange(other.mutex_, nullptr)) {}
+  async_mutex_lock& operator=(async_mutex_lock other) noexcept
+  {
+    std::swap(mutex_, other.mutex_);
+    return *this;
+  }
+  ~async_mutex_lock();
+
+  [[nodiscard]] async_mutex* mutex() const noexcept { return mutex_; }
+
+private:
+  async_mutex* mutex_;
+};
+
+// A mutex suspending the awaiting coroutine (instead of blocking the thread) when the lock is not available.
+//
+// The whole state is one atomic word: "not locked", "locked without waiters", or the head of a stack of
+// the waiting coroutines. The waiters are intrusive nodes stored in the awaiters so no allocation happens.
+// The lock holder moves the stack to a private FIFO list on `unlock()` and hands the lock over directly
+// to the longest waiting coroutine which is resumed on the unlocking thread. The coroutines are resumed
+// through the thread's trampoline so a chain of hand-overs between the queued waiters does not grow the stack.
+class async_mutex : private detail::noncopyable {
+public:
+  class [[nodiscard]] lock_awaitable {
+  public:
+    explicit lock_awaitable(async_mutex& mutex) noexcept : mutex_(mutex) {}
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return mutex_.try_lock();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle) noexcept
+    {
+      TRACE_FUNC();
+      node_.handle = handle;
+      return mutex_.enqueue(node_);
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  protected:
+    async_mutex& mutex_;
+
+  private:
+    friend class async_mutex;
+
+    detail::trampoline_node node_;
+  };
+
+  class [[nodiscard]] scoped_lock_awaitable : public lock_awaitable {
+  public:
+    using lock_awaitable::lock_awaitable;
+
+    async_mutex_lock await_resume() const noexcept
+    {
+      TRACE_FUNC();
+      return async_mutex_lock(mutex_, std::adopt_lock);
+    }
+  };
+
+  async_mutex() noexcept = default;
+
+  ~async_mutex()
+  {
+    [[maybe_unused]] void* state = state_.load(std::memory_order_relaxed);
+    assert((state == not_locked() || state == nullptr) && waiters_ == nullptr);
+  }
+
+  [[nodiscard]] bool try_lock() noexcept
+  {
+    void* expected = not_locked();
+    return state_.compare_exchange_strong(expected, nullptr, std::memory_order_acquire, std::memory_order_relaxed);
+  }
+
+  // `co_await mutex.lock()` has to be paired with `mutex.unlock()`
+  [[nodiscard]] lock_awaitable lock() noexcept { return lock_awaitable(*this); }
+
+  // `co_await mutex.scoped_lock()` returns an `async_mutex_lock` unlocking the mutex at the end of its scope
+  [[nodiscard]] scoped_lock_awaitable scoped_lock() noexcept { return scoped_lock_awaitable(*this); }
+
+  void unlock()
+  {
+    TRACE_FUNC();
+    assert(state_.load(std::memory_order_relaxed) != not_locked());
+    detail::trampoline_node* waiter = waiters_;
+    if (!waiter) {
+      void* expected = nullptr;
+      if (state_.compare_exchange_strong(expected, not_locked(), std::memory_order_release,
+                                         std::memory_order_relaxed))
+        return;
+      // take all of the new waiters and reverse them to the FIFO order
+      auto* stack = static_cast<detail::trampoline_node*>(state_.exchange(nullptr, std::memory_order_acquire));
+      do {
+        detail::trampoline_node* next = stack->next;
+        stack->next = waiter;
+        waiter = stack;
+        stack = next;
+      } while (stack);
+    }
+    waiters_ = waiter->next;
+    detail::trampoline_resume(*waiter);
+  }
+
+private:
+  // `this` means "not locked", `nullptr` "locked without waiters" and any other value is the top of
+  // the stack of newly enqueued waiters
+  std::atomic<void*> state_{not_locked()};
+  detail::trampoline_node* waiters_ = nullptr;  // FIFO of the waiters already taken by the lock holder
+
+  void* not_locked() noexcept { return this; }
+
+  // Returns false if the mutex got locked in the meantime and the coroutine should not be suspended
+  bool enqueue(detail::trampoline_node& waiter) noexcept
+  {
+    void* state = state_.load(std::memory_order_relaxed);
+    while (true) {
+      if (state == not_locked()) {
+        if (state_.compare_exchange_weak(state, nullptr, std::memory_order_acquire, std::memory_order_relaxed))
+          return false;
+      } else {
+        waiter.next = static_cast<detail::trampoline_node*>(state);
+        if (state_.compare_exchange_weak(state, &waiter, std::memory_order_release, std::memory_order_relaxed))
+          return true;
+      }
+    }
+  }
+};
+
+inline async_mutex_lock::~async_mutex_lock()
+{
+  if (mutex_) mutex_->unlock();
+}
+
+}  // namespace mp_coro
@@ -0,0 +1,191 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/trampoline.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/trace.h>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+namespace mp_coro {
+
+class async_semaphore;
+
+// Releases the owned permit of `async_semaphore` when destroyed
+class [[nodiscard]] async_semaphore_permit {
+public:
+  explicit async_semaphore_permit(async_semaphore& semaphore, std::adopt_lock_t) noexcept : semaphore_(&semaphore) {}
+  async_semaphore_permit(async_semaphore_permit&& other) noexcept :
+      semaphore_(std::exchange(other.semaphore_, nullptr))
+  {
+  }
+  async_semaphore_permit& operator=(async_semaphore_permit other) noexcept
+  {
+    std::swap(semaphore_, other.semaphore_);
+    return *this;
+  }
+  ~async_semaphore_permit();
+
+private:
+  async_semaphore* semaphore_;
+};
+
+// A counting semaphore suspending the awaiting coroutine (instead of blocking the thread) when no permits
+// are available.
+//
+// The counter is an atomic word which goes negative by the number of (about to be) suspended coroutines.
+// Acquiring an available permit and releasing permits when no one waits never takes the lock. The lock
+// guards only the intrusive FIFO of the waiters (stored in the awaiters) and is taken once per `release(n)`
+// regardless of the number of the resumed coroutines. The waiters are resumed on the releasing thread through
+// its trampoline so the `release()` calls of the resumed coroutines do not resume the next waiters recursively.
+class async_semaphore : private detail::noncopyable {
+public:
+  class [[nodiscard]] acquire_awaitable {
+  public:
+    explicit acquire_awaitable(async_semaphore& semaphore) noexcept : semaphore_(semaphore) {}
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return semaphore_.try_acquire();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      node_.handle = handle;
+      return semaphore_.enqueue(node_);
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  protected:
+    async_semaphore& semaphore_;
+
+  private:
+    friend class async_semaphore;
+
+    detail::trampoline_node node_;
+  };
+
+  class [[nodiscard]] scoped_acquire_awaitable : public acquire_awaitable {
+  public:
+    using acquire_awaitable::acquire_awaitable;
+
+    async_semaphore_permit await_resume() const noexcept
+    {
+      TRACE_FUNC();
+      return async_semaphore_permit(semaphore_, std::adopt_lock);
+    }
+  };
+
+  explicit async_semaphore(std::ptrdiff_t initial) noexcept : count_(initial) { assert(initial >= 0); }
+
+  ~async_semaphore() { assert(head_ == nullptr && "the semaphore is destroyed with suspended waiters"); }
+
+  // The number of permits available (negative if there are waiters)
+  [[nodiscard]] std::ptrdiff_t available() const noexcept { return count_.load(std::memory_order_relaxed); }
+
+  [[nodiscard]] bool try_acquire() noexcept
+  {
+    std::ptrdiff_t count = count_.load(std::memory_order_relaxed);
+    while (count > 0)
+      if (count_.compare_exchange_weak(count, count - 1, std::memory_order_acquire, std::memory_order_relaxed))
+        return true;
+    return false;
+  }
+
+  // `co_await semaphore.acquire()` has to be paired with `semaphore.release()`
+  [[nodiscard]] acquire_awaitable acquire() noexcept { return acquire_awaitable(*this); }
+
+  // `co_await semaphore.scoped_acquire()` returns an `async_semaphore_permit` releasing the permit at the end
+  // of its scope
+  [[nodiscard]] scoped_acquire_awaitable scoped_acquire() noexcept { return scoped_acquire_awaitable(*this); }
+
+  // Returns `n` permits waking up to `n` of the waiting coroutines
+  void release(std::ptrdiff_t n = 1)
+  {
+    TRACE_FUNC();
+    assert(n >= 0);
+    const std::ptrdiff_t old = count_.fetch_add(n, std::memory_order_release);
+    std::ptrdiff_t wake = std::min(n, -old);
+    if (wake <= 0) return;
+
+    detail::trampoline_node* first = nullptr;
+    detail::trampoline_node* last = nullptr;
+    {
+      std::lock_guard lock(mutex_);
+      if (head_) {
+        first = last = head_;
+        while (--wake > 0 && last->next) last = last->next;
+        head_ = std::exchange(last->next, nullptr);
+        if (!head_) tail_ = nullptr;
+      }
+      // the rest of the permits go to the coroutines that decremented the counter but are not enqueued yet
+      handed_over_ += wake;
+    }
+    if (first) detail::trampoline_resume(*first, *last);
+  }
+
+private:
+  std::atomic<std::ptrdiff_t> count_;
+  std::mutex mutex_;
+  std::ptrdiff_t handed_over_ = 0;
+  detail::trampoline_node* head_ = nullptr;  // FIFO of the suspended coroutines
+  detail::trampoline_node* tail_ = nullptr;
+
+  // Returns false if a permit was acquired without waiting and the coroutine should not be suspended
+  bool enqueue(detail::trampoline_node& waiter)
+  {
+    if (count_.fetch_sub(1, std::memory_order_acquire) > 0) return false;
+    std::lock_guard lock(mutex_);
+    if (handed_over_ > 0) {
+      --handed_over_;
+      return false;
+    }
+    if (tail_)
+      tail_->next = &waiter;
+    else
+      head_ = &waiter;
+    tail_ = &waiter;
+    return true;
+  }
+};
+
+static_assert(awaitable_of<async_semaphore::acquire_awaitable, void>);
+static_assert(awaitable_of<async_semaphore::scoped_acquire_awaitable, async_semaphore_permit>);
+
+inline async_semaphore_permit::~async_semaphore_permit()
+{
+  if (semaphore_) semaphore_->release();
+}
+
+}  // namespace mp_coro
@@ -0,0 +1,120 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/cache_line.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <optional>
+#include <type_traits>
+
+namespace mp_coro::detail {
+
+// Bounded multi-producer/multi-consumer queue (Dmitry Vyukov's design).
+//
+// Each cell has a sequence number telling whether it is ready to be written or read at the given position
+// so producers and consumers claim positions with a single CAS and don't touch each other's counters.
+// The capacity is rounded up to a power of two (at least 2).
+//
+// Publishing and checking the cells is sequentially consistent so that the caller may use a Dekker-style
+// handshake with a "waiting" counter (store to the cell, load of the counter vs. store to the counter,
+// load of the cell) without additional fences.
+template<typename T>
+class bounded_mpmc_queue : private noncopyable {
+  static_assert(std::is_nothrow_move_constructible_v<T>, "a claimed cell has to be filled");
+public:
+  explicit bounded_mpmc_queue(std::size_t capacity) :
+      mask_(std::bit_ceil(std::max(capacity, std::size_t{2})) - 1), cells_(new cell[mask_ + 1])
+  {
+    for (std::size_t i = 0; i <= mask_; ++i) cells_[i].seq.store(i, std::memory_order_relaxed);
+  }
+
+  ~bounded_mpmc_queue()
+  {
+    while (try_pop()) {}
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return mask_ + 1; }
+
+  // Moves from `value` only on success
+  bool try_push(T& value) noexcept
+  {
+    std::size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells_[pos & mask_];
+      const std::size_t seq = c.seq.load(std::memory_order_seq_cst);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          std::construct_at(reinterpret_cast<T*>(c.storage), std::move(value));
+          c.seq.store(pos + 1, std::memory_order_seq_cst);
+          return true;
+        }
+      } else if (diff < 0)
+        return false;  // full
+      else
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+  std::optional<T> try_pop() noexcept
+  {
+    std::size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+    while (true) {
+      cell& c = cells_[pos & mask_];
+      const std::size_t seq = c.seq.load(std::memory_order_seq_cst);
+      const auto diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          std::optional<T> result(std::move(*c.get()));
+          std::destroy_at(c.get());
+          c.seq.store(pos + mask_ + 1, std::memory_order_seq_cst);
+          return result;
+        }
+      } else if (diff < 0)
+        return std::nullopt;  // empty
+      else
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+    }
+  }
+
+private:
+  struct cell {
+    std::atomic<std::size_t> seq;
+    alignas(T) std::byte storage[sizeof(T)];
+    T* get() noexcept { return std::launder(reinterpret_cast<T*>(storage)); }
+  };
+
+  const std::size_t mask_;
+  std::unique_ptr<cell[]> cells_;
+  alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos_ = 0;
+  alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos_ = 0;
+};
+
+}  // namespace mp_coro::detail
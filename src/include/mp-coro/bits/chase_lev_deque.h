@@ -0,0 +1,140 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/cache_line.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace mp_coro::detail {
+
+// Chase-Lev work-stealing deque of coroutine handles
+// (based on "Correct and Efficient Work-Stealing for Weak Memory Models" by Lê, Pop, Cohen, and Zappa Nardelli).
+//
+// Only the owning thread may call `push()` and `pop()` that operate on the bottom end of the deque.
+// Any thread may call `steal()` that takes the oldest item from the top end.
+class chase_lev_deque : private noncopyable {
+  class ring_buffer {
+    std::int64_t capacity_;
+    std::int64_t mask_;
+    std::unique_ptr<std::atomic<void*>[]> items_;
+  public:
+    explicit ring_buffer(std::int64_t capacity) :
+        capacity_(capacity),
+        mask_(capacity - 1),
+        items_(std::make_unique<std::atomic<void*>[]>(static_cast<std::size_t>(capacity)))
+    {
+    }
+    [[nodiscard]] std::int64_t capacity() const noexcept { return capacity_; }
+    void store(std::int64_t index, void* ptr) noexcept
+    {
+      items_[static_cast<std::size_t>(index & mask_)].store(ptr, std::memory_order_relaxed);
+    }
+    [[nodiscard]] void* load(std::int64_t index) const noexcept
+    {
+      return items_[static_cast<std::size_t>(index & mask_)].load(std::memory_order_relaxed);
+    }
+  };
+
+  alignas(cache_line_size) std::atomic<std::int64_t> top_ = 0;
+  alignas(cache_line_size) std::atomic<std::int64_t> bottom_ = 0;
+  std::atomic<ring_buffer*> buffer_;
+  // thieves may still read from the old buffers so they are kept alive until the deque is destroyed
+  std::vector<std::unique_ptr<ring_buffer>> buffers_;
+
+  ring_buffer* grow(ring_buffer* old, std::int64_t top, std::int64_t bottom)
+  {
+    auto& buf = buffers_.emplace_back(std::make_unique<ring_buffer>(old->capacity() * 2));
+    for (auto i = top; i != bottom; ++i) buf->store(i, old->load(i));
+    buffer_.store(buf.get(), std::memory_order_release);
+    return buf.get();
+  }
+
+public:
+  // `initial_capacity` has to be a power of 2
+  explicit chase_lev_deque(std::int64_t initial_capacity = 256)
+  {
+    auto& buf = buffers_.emplace_back(std::make_unique<ring_buffer>(initial_capacity));
+    buffer_.store(buf.get(), std::memory_order_relaxed);
+  }
+
+  // Owner only
+  void push(std::coroutine_handle<> handle)
+  {
+    const auto bottom = bottom_.load(std::memory_order_relaxed);
+    const auto top = top_.load(std::memory_order_acquire);
+    auto* buf = buffer_.load(std::memory_order_relaxed);
+    if (bottom - top > buf->capacity() - 1) buf = grow(buf, top, bottom);
+    buf->store(bottom, handle.address());
+    bottom_.store(bottom + 1, std::memory_order_release);
+  }
+
+  // Owner only
+  [[nodiscard]] std::coroutine_handle<> pop() noexcept
+  {
+    const auto bottom = bottom_.load(std::memory_order_relaxed) - 1;
+    auto* buf = buffer_.load(std::memory_order_relaxed);
+    bottom_.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto top = top_.load(std::memory_order_relaxed);
+    if (top > bottom) {
+      // deque was empty
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    void* ptr = buf->load(bottom);
+    if (top == bottom) {
+      // the last item - race against thieves
+      if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        ptr = nullptr;
+      bottom_.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return std::coroutine_handle<>::from_address(ptr);
+  }
+
+  // Any thread
+  [[nodiscard]] std::coroutine_handle<> steal() noexcept
+  {
+    auto top = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const auto bottom = bottom_.load(std::memory_order_acquire);
+    if (top >= bottom) return nullptr;
+    void* ptr = buffer_.load(std::memory_order_acquire)->load(top);
+    if (!top_.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+      return nullptr;  // lost the race with another thief or the owner
+    return std::coroutine_handle<>::from_address(ptr);
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+  }
+};
+
+}  // namespace mp_coro::detail
@@ -0,0 +1,199 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace mp_coro::detail {
+
+// Thread-local size-class free lists for coroutine frames.
+//
+// Every block is preceded with a header pointing to the thread cache that allocated it. Blocks released
+// on the owning thread go back to its local free list. Blocks released on other threads are pushed to
+// the owner's lock-free "remote" list that the owner drains once its local list for a size class runs out.
+// When a thread exits its cache is closed, cached blocks are returned to the system, and the cache itself
+// is destroyed once the last of its outstanding blocks is released.
+class frame_pool {
+public:
+  static constexpr std::size_t granularity = 64;
+  static constexpr std::size_t size_classes_count = 32;  // up to 2 KiB frames are recycled
+  static constexpr std::size_t max_cached_blocks = 1024;  // per size class
+
+  [[nodiscard]] static void* allocate(std::size_t size)
+  {
+    const std::size_t size_class = (size + sizeof(header) + granularity - 1) / granularity - 1;
+    thread_cache* cache = size_class < size_classes_count ? local_cache() : nullptr;
+    if (!cache) return system_allocate(nullptr, 0, size + sizeof(header));
+    return cache->allocate(size_class);
+  }
+
+  static void deallocate(void* ptr) noexcept
+  {
+    auto* h = static_cast<header*>(ptr) - 1;
+    thread_cache* owner = h->owner;
+    if (!owner)
+      ::operator delete(h);
+    else if (owner == local_state().cache)
+      owner->deallocate_local(h);
+    else
+      owner->deallocate_remote(h);
+  }
+
+private:
+  class thread_cache;
+
+  // keeps the payload aligned to `__STDCPP_DEFAULT_NEW_ALIGNMENT__`
+  struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) header {
+    thread_cache* owner;
+    std::size_t size_class;
+    header* next;  // valid only when a block is free
+  };
+
+  static void* system_allocate(thread_cache* owner, std::size_t size_class, std::size_t bytes)
+  {
+    auto* h = ::new (::operator new(bytes)) header{owner, size_class, nullptr};
+    return h + 1;
+  }
+
+  class thread_cache : private noncopyable {
+    header* free_lists_[size_classes_count] = {};
+    std::size_t cached_[size_classes_count] = {};
+    std::ptrdiff_t outstanding_ = 0;  // blocks handed out and not yet returned to the local free lists
+    alignas(64) std::atomic<header*> remote_list_ = nullptr;
+    std::atomic<std::ptrdiff_t> orphaned_ = 0;
+
+    static header* closed() noexcept
+    {
+      static header marker{};
+      return &marker;
+    }
+
+    void drain_remote_list() noexcept
+    {
+      header* h = remote_list_.exchange(nullptr, std::memory_order_acquire);
+      while (h) {
+        header* next = h->next;
+        deallocate_local(h);
+        h = next;
+      }
+    }
+
+    void release_orphaned(std::ptrdiff_t count) noexcept
+    {
+      if (orphaned_.fetch_sub(count, std::memory_order_acq_rel) == count) delete this;
+    }
+
+  public:
+    thread_cache() = default;
+
+    void* allocate(std::size_t size_class)
+    {
+      if (!free_lists_[size_class]) drain_remote_list();
+      ++outstanding_;
+      if (header* h = free_lists_[size_class]) {
+        free_lists_[size_class] = h->next;
+        --cached_[size_class];
+        return h + 1;
+      }
+      return system_allocate(this, size_class, (size_class + 1) * granularity);
+    }
+
+    void deallocate_local(header* h) noexcept
+    {
+      --outstanding_;
+      if (cached_[h->size_class] == max_cached_blocks) {
+        ::operator delete(h);
+        return;
+      }
+      h->next = std::exchange(free_lists_[h->size_class], h);
+      ++cached_[h->size_class];
+    }
+
+    void deallocate_remote(header* h) noexcept
+    {
+      header* head = remote_list_.load(std::memory_order_relaxed);
+      do {
+        if (head == closed()) {
+          // the owning thread has already exited
+          ::operator delete(h);
+          release_orphaned(1);
+          return;
+        }
+        h->next = head;
+      } while (!remote_list_.compare_exchange_weak(head, h, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // Called on the owning thread exit
+    void close() noexcept
+    {
+      header* h = remote_list_.exchange(closed(), std::memory_order_acquire);
+      while (h) {
+        header* next = h->next;
+        deallocate_local(h);
+        h = next;
+      }
+      for (auto& list : free_lists_)
+        while (list) ::operator delete(std::exchange(list, list->next));
+      // `orphaned_` may already be negative if remote deallocations happened after the cache was closed
+      release_orphaned(-outstanding_);
+    }
+  };
+
+  // trivially destructible so it can be safely accessed during the thread exit
+  struct thread_state {
+    thread_cache* cache = nullptr;
+    bool exited = false;
+  };
+
+  static thread_state& local_state() noexcept
+  {
+    static constinit thread_local thread_state state;
+    return state;
+  }
+
+  struct cache_holder {
+    thread_cache* cache = new thread_cache;
+    ~cache_holder()
+    {
+      local_state() = {nullptr, true};
+      cache->close();
+    }
+  };
+
+  static thread_cache* local_cache()
+  {
+    auto& state = local_state();
+    if (!state.cache && !state.exited) {
+      static thread_local cache_holder holder;
+      state.cache = holder.cache;
+    }
+    return state.cache;
+  }
+};
+
+}  // namespace mp_coro::detail
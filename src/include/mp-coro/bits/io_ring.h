@@ -0,0 +1,197 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstddef>
+#include <cstring>
+#include <system_error>
+#include <thread>
+
+namespace mp_coro::detail {
+
+// A minimal io_uring instance driven with raw system calls.
+//
+// The submission queue is not thread-safe and has to be guarded by the caller. The completion queue
+// is consumed by a single thread.
+class io_ring : private noncopyable {
+public:
+  explicit io_ring(unsigned entries)
+  {
+    io_uring_params params{};
+    fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0) throw std::system_error(errno, std::system_category(), "io_uring_setup");
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_NODROP)) {
+      ::close(fd_);
+      throw std::system_error(std::make_error_code(std::errc::function_not_supported), "io_uring");
+    }
+
+    ring_size_ = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe));
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    ring_ = map(ring_size_, IORING_OFF_SQ_RING);
+    if (ring_ != MAP_FAILED) sqes_ = static_cast<io_uring_sqe*>(map(sqes_size_, IORING_OFF_SQES));
+    if (ring_ == MAP_FAILED || sqes_ == MAP_FAILED) {
+      const int error = errno;
+      if (ring_ != MAP_FAILED) ::munmap(ring_, ring_size_);
+      ::close(fd_);
+      throw std::system_error(error, std::system_category(), "io_uring mmap");
+    }
+
+    auto* base = static_cast<std::byte*>(ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    sq_array_ = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    sq_mask_ = *reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    sq_entries_ = params.sq_entries;
+    cq_head_ = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    tail_ = *sq_tail_;
+  }
+
+  ~io_ring()
+  {
+    ::munmap(sqes_, sqes_size_);
+    ::munmap(ring_, ring_size_);
+    ::close(fd_);
+  }
+
+  // Returns a cleared submission queue entry or `nullptr` if the queue is full
+  [[nodiscard]] io_uring_sqe* get_sqe() noexcept
+  {
+    if (tail_ - std::atomic_ref(*sq_head_).load(std::memory_order_acquire) >= sq_entries_) return nullptr;
+    const unsigned index = tail_++ & sq_mask_;
+    sq_array_[index] = index;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    ++pending_;
+    return sqe;
+  }
+
+  // The number of entries not submitted to the kernel yet
+  [[nodiscard]] unsigned pending() const noexcept { return pending_; }
+
+  // Submits all of the pending entries with a single system call.
+  // Returns false if the kernel is temporarily out of resources and the submission should be retried later.
+  bool submit()
+  {
+    if (pending_ == 0) return true;
+    std::atomic_ref(*sq_tail_).store(tail_, std::memory_order_release);
+    while (true) {
+      const int ret = enter(pending_, 0, 0);
+      if (ret >= 0) {
+        pending_ -= static_cast<unsigned>(ret);
+        return pending_ == 0;
+      }
+      if (errno == EBUSY || errno == EAGAIN) return false;
+      if (errno != EINTR) throw std::system_error(errno, std::system_category(), "io_uring_enter");
+    }
+  }
+
+  // Registers fixed buffers for `IORING_OP_READ_FIXED`/`IORING_OP_WRITE_FIXED`.
+  // Returns false if the kernel refused to pin the memory (i.e. because of `RLIMIT_MEMLOCK`).
+  bool register_buffers(const iovec* buffers, unsigned count) noexcept
+  {
+    return ::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+  }
+
+  void unregister_buffers() noexcept { ::syscall(__NR_io_uring_register, fd_, IORING_UNREGISTER_BUFFERS, nullptr, 0); }
+
+  // Blocks until at least one completion is available.
+  // Returns right away if the kernel keeps the completions that did not fit in the queue (they are moved to
+  // the queue as the ones already in there are reaped).
+  void wait()
+  {
+    while (enter(0, 1, IORING_ENTER_GETEVENTS) < 0) {
+      if (errno == EBUSY) return;
+      if (errno == EAGAIN)
+        back_off();
+      else if (errno != EINTR)
+        throw std::system_error(errno, std::system_category(), "io_uring_enter");
+    }
+  }
+
+  // Pauses the thread when the kernel is temporarily out of memory
+  static void back_off() { std::this_thread::sleep_for(std::chrono::microseconds(50)); }
+
+  // Calls `f(cqe)` for all of the available completions and returns their number
+  template<typename F>
+  unsigned reap(F f)
+  {
+    std::atomic_ref head_ref(*cq_head_);
+    unsigned head = head_ref.load(std::memory_order_relaxed);
+    const unsigned tail = std::atomic_ref(*cq_tail_).load(std::memory_order_acquire);
+    const unsigned count = tail - head;
+    for (; head != tail; ++head) {
+      const io_uring_cqe cqe = cqes_[head & cq_mask_];
+      // release the entry before the handler possibly resumes a coroutine
+      head_ref.store(head + 1, std::memory_order_release);
+      f(cqe);
+    }
+    return count;
+  }
+
+private:
+  int fd_;
+  void* ring_ = nullptr;
+  std::size_t ring_size_ = 0;
+  io_uring_sqe* sqes_ = nullptr;
+  std::size_t sqes_size_ = 0;
+  unsigned* sq_head_;
+  unsigned* sq_tail_;
+  unsigned* sq_array_;
+  unsigned sq_mask_;
+  unsigned sq_entries_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+  unsigned tail_;  // the local tail of the submission queue
+  unsigned pending_ = 0;
+
+  void* map(std::size_t size, off_t offset) const noexcept
+  {
+    return ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+  }
+
+  int enter(unsigned to_submit, unsigned min_complete, unsigned flags) noexcept
+  {
+    return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, fd_, to_submit, min_complete, flags, nullptr, _NSIG / 8));
+  }
+};
+
+}  // namespace mp_coro::detail
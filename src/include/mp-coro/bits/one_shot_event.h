@@ -0,0 +1,95 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace mp_coro::detail {
+
+inline void cpu_relax() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+// A single-shot event set by one thread and waited for by another one.
+//
+// The waiter spins for a while before parking on `std::atomic::wait()`. The length of the spin phase adapts
+// to the recent history of the waiting thread: it grows when the event gets set while spinning and shrinks
+// when the thread has to park anyway (there is no spinning on single-core machines).
+class one_shot_event : private noncopyable {
+public:
+  void set() noexcept
+  {
+    state expected = state::unset;
+    if (state_.compare_exchange_strong(expected, state::set, std::memory_order_release, std::memory_order_relaxed))
+      return;
+    // the waiter is parked; it may return as soon as it observes `set` so the event can't be touched afterwards
+    state_.store(state::notifying, std::memory_order_relaxed);
+    state_.notify_one();
+    state_.store(state::set, std::memory_order_release);
+  }
+
+  [[nodiscard]] bool is_set() const noexcept { return state_.load(std::memory_order_acquire) == state::set; }
+
+  void wait() noexcept
+  {
+    if (spin()) return;
+    state expected = state::unset;
+    if (state_.compare_exchange_strong(expected, state::waiting, std::memory_order_relaxed))
+      state_.wait(state::waiting, std::memory_order_relaxed);
+    while (state_.load(std::memory_order_acquire) != state::set) cpu_relax();
+  }
+
+private:
+  enum class state : std::uint8_t { unset, waiting, notifying, set };
+  static constexpr std::uint32_t min_spin = 16;
+  static constexpr std::uint32_t max_spin = 4096;
+  static inline thread_local std::uint32_t spin_limit_ = 256;
+  std::atomic<state> state_{state::unset};
+
+  bool spin() noexcept
+  {
+    static const bool multicore = std::thread::hardware_concurrency() > 1;
+    if (!multicore) return is_set();
+    for (std::uint32_t i = 0; i < spin_limit_; ++i) {
+      if (is_set()) {
+        spin_limit_ = std::min(spin_limit_ * 2, max_spin);
+        return true;
+      }
+      cpu_relax();
+    }
+    spin_limit_ = std::max(spin_limit_ / 2, min_spin);
+    return is_set();
+  }
+};
+
+}  // namespace mp_coro::detail
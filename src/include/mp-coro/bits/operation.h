@@ -0,0 +1,122 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/stop_scope.h>
+#include <mp-coro/bits/synchronized_task.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/task.h>
+#include <mp-coro/trace.h>
+#include <mp-coro/type_traits.h>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace mp_coro::detail {
+
+template<typename T>
+inline constexpr bool is_task = false;
+
+template<typename T, typename Allocator>
+inline constexpr bool is_task<task<T, Allocator>> = true;
+
+// Starts a `task` and makes its promise notify `Sync` directly from the final suspend point so no additional
+// coroutine frame is needed. Provides the same interface and results as a `synchronized_task` wrapping the task.
+// An rvalue task (`A` is not a reference) is owned by the operation, an lvalue one is referenced.
+template<typename Sync, typename A>
+class task_operation {
+  A task_;
+public:
+  using value_type = remove_rvalue_reference_t<await_result_t<A>>;
+
+  explicit task_operation(A&& t) : task_(std::forward<A>(t)) {}
+
+  void start(Sync& s, lazy_stop_token token = {})
+  {
+    using promise_type = typename std::remove_cvref_t<A>::promise_type;
+    promise_type& promise = *task_.promise_;
+    auto handle = std::coroutine_handle<promise_type>::from_promise(promise);
+    if (handle.done()) {
+      // a result of the already awaited task is ready
+      notify_completed(s, promise.has_exception());
+      return;
+    }
+    promise.sync = &s;
+    promise.notify_completed = [](promise_type& p) noexcept {
+      notify_completed(*static_cast<Sync*>(p.sync), p.has_exception());
+    };
+    promise.stop_token = std::move(token);
+    handle.resume();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&
+  {
+    TRACE_FUNC();
+    return std::as_const(*task_.promise_).get();
+  }
+
+  [[nodiscard]] decltype(auto) get() const&&
+  {
+    TRACE_FUNC();
+    if constexpr (std::is_reference_v<A>)
+      return std::as_const(*task_.promise_).get();
+    else
+      return std::move(*task_.promise_).get();
+  }
+};
+
+// `task` is started directly while other awaitables are wrapped with a `synchronized_task`.
+// Rvalue awaitables (`A` is not a reference) are moved to the operation, lvalue ones are referenced.
+template<typename Sync, typename A>
+  requires awaitable<A>
+auto make_operation(A&& awaitable)
+{
+  if constexpr (is_task<std::remove_cvref_t<A>>)
+    return task_operation<Sync, A>(std::forward<A>(awaitable));
+  else
+    return make_owning_synchronized_task<Sync, A>(std::forward<A>(awaitable));
+}
+
+// Creates operations for all of the awaitables from a range in a single contiguous block allocated with `alloc`.
+// Elements of an rvalue range are moved to the operations.
+template<typename Sync, std::ranges::range R, typename Alloc = std::allocator<std::byte>>
+  requires awaitable<std::ranges::range_value_t<R>>
+auto make_operations(R&& awaitables, const Alloc& alloc = Alloc())
+{
+  using element_type = std::conditional_t<std::is_lvalue_reference_v<R>, std::ranges::range_reference_t<R>,
+                                          std::ranges::range_value_t<R>>;
+  using operation_type = decltype(make_operation<Sync, element_type>(std::declval<element_type>()));
+  using allocator_type = typename std::allocator_traits<Alloc>::template rebind_alloc<operation_type>;
+  std::vector<operation_type, allocator_type> operations{allocator_type(alloc)};
+  operations.reserve(size(awaitables));
+  for (auto&& awaitable : awaitables)
+    operations.emplace_back(make_operation<Sync, element_type>(static_cast<element_type&&>(awaitable)));
+  return operations;
+}
+
+}  // namespace mp_coro::detail
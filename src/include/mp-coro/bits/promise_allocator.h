@@ -0,0 +1,177 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#if MP_CORO_FRAME_RECYCLING
+#include <mp-coro/recycling_allocator.h>
+#endif
+#include <concepts>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace mp_coro::detail {
+
+// Coroutine frames are allocated as arrays of blocks to preserve the default `operator new` alignment
+struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) aligned_block {
+  std::byte data[__STDCPP_DEFAULT_NEW_ALIGNMENT__];
+};
+
+template<typename Alloc>
+using block_allocator_t = typename std::allocator_traits<Alloc>::template rebind_alloc<aligned_block>;
+
+[[nodiscard]] constexpr std::size_t align_up(std::size_t size, std::size_t alignment) noexcept
+{
+  return (size + alignment - 1) & ~(alignment - 1);
+}
+
+[[nodiscard]] constexpr std::size_t blocks_count(std::size_t size) noexcept
+{
+  return (size + sizeof(aligned_block) - 1) / sizeof(aligned_block);
+}
+
+template<typename Alloc>
+inline constexpr bool stateless_allocator =
+  std::default_initializable<Alloc> && std::allocator_traits<Alloc>::is_always_equal::value;
+
+// Allocates `size` bytes for a coroutine frame with `alloc`.
+// A copy of a stateful allocator is stored right after the frame so it can be used for deallocation.
+template<typename Alloc>
+[[nodiscard]] void* allocate_frame(const Alloc& alloc, std::size_t size)
+{
+  using block_alloc = block_allocator_t<Alloc>;
+  using traits = std::allocator_traits<block_alloc>;
+  static_assert(alignof(block_alloc) <= alignof(aligned_block), "Over-aligned allocators are not supported");
+
+  block_alloc a(alloc);
+  if constexpr (stateless_allocator<block_alloc>)
+    return traits::allocate(a, blocks_count(size));
+  else {
+    const std::size_t alloc_offset = align_up(size, alignof(block_alloc));
+    void* ptr = traits::allocate(a, blocks_count(alloc_offset + sizeof(block_alloc)));
+    ::new (static_cast<std::byte*>(ptr) + alloc_offset) block_alloc(std::move(a));
+    return ptr;
+  }
+}
+
+template<typename Alloc>
+void deallocate_frame(void* ptr, std::size_t size) noexcept
+{
+  using block_alloc = block_allocator_t<Alloc>;
+  using traits = std::allocator_traits<block_alloc>;
+
+  if constexpr (stateless_allocator<block_alloc>) {
+    block_alloc a;
+    traits::deallocate(a, static_cast<aligned_block*>(ptr), blocks_count(size));
+  } else {
+    const std::size_t alloc_offset = align_up(size, alignof(block_alloc));
+    auto* stored = std::launder(reinterpret_cast<block_alloc*>(static_cast<std::byte*>(ptr) + alloc_offset));
+    block_alloc a(std::move(*stored));
+    stored->~block_alloc();
+    traits::deallocate(a, static_cast<aligned_block*>(ptr), blocks_count(alloc_offset + sizeof(block_alloc)));
+  }
+}
+
+// Type-erased version used when a coroutine return type does not fix the allocator type.
+// A pointer to the deallocation function is stored right after the frame (followed by an allocator if needed).
+using deallocate_frame_fn = void (*)(void*, std::size_t) noexcept;
+
+template<typename Alloc>
+[[nodiscard]] void* allocate_erased_frame(const Alloc& alloc, std::size_t size)
+{
+  const std::size_t fn_offset = align_up(size, alignof(deallocate_frame_fn));
+  void* ptr = allocate_frame(alloc, fn_offset + sizeof(deallocate_frame_fn));
+  ::new (static_cast<std::byte*>(ptr) + fn_offset) deallocate_frame_fn(&deallocate_frame<Alloc>);
+  return ptr;
+}
+
+inline void deallocate_erased_frame(void* ptr, std::size_t size) noexcept
+{
+  const std::size_t fn_offset = align_up(size, alignof(deallocate_frame_fn));
+  const auto fn = *std::launder(reinterpret_cast<deallocate_frame_fn*>(static_cast<std::byte*>(ptr) + fn_offset));
+  fn(ptr, fn_offset + sizeof(deallocate_frame_fn));
+}
+
+// A base class for promise types that provides coroutine frame allocation with `Allocator`.
+//
+// The allocator can also be provided in the coroutine parameter list as `std::allocator_arg, alloc`
+// arguments (for member functions right after the implicit object parameter).
+template<typename Allocator>
+struct promise_allocator {
+  [[nodiscard]] static void* operator new(std::size_t size)
+    requires std::default_initializable<Allocator>
+  {
+    return allocate_frame(Allocator(), size);
+  }
+
+  template<typename Alloc, typename... Args>
+    requires std::convertible_to<const Alloc&, Allocator>
+  [[nodiscard]] static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+  {
+    return allocate_frame(static_cast<Allocator>(alloc), size);
+  }
+
+  template<typename This, typename Alloc, typename... Args>
+    requires std::convertible_to<const Alloc&, Allocator>
+  [[nodiscard]] static void* operator new(std::size_t size, const This&, std::allocator_arg_t, const Alloc& alloc,
+                                          const Args&...)
+  {
+    return allocate_frame(static_cast<Allocator>(alloc), size);
+  }
+
+  static void operator delete(void* ptr, std::size_t size) noexcept { deallocate_frame<Allocator>(ptr, size); }
+};
+
+#if MP_CORO_FRAME_RECYCLING
+using default_frame_allocator = recycling_allocator<aligned_block>;
+#else
+using default_frame_allocator = std::allocator<aligned_block>;
+#endif
+
+// Any allocator can be provided in the coroutine parameter list when the `Allocator` type is not specified.
+// Otherwise, `default_frame_allocator` is used (recycling frames if `MP_CORO_FRAME_RECYCLING` is enabled).
+template<>
+struct promise_allocator<void> {
+  [[nodiscard]] static void* operator new(std::size_t size)
+  {
+    return allocate_erased_frame(default_frame_allocator(), size);
+  }
+
+  template<typename Alloc, typename... Args>
+  [[nodiscard]] static void* operator new(std::size_t size, std::allocator_arg_t, const Alloc& alloc, const Args&...)
+  {
+    return allocate_erased_frame(alloc, size);
+  }
+
+  template<typename This, typename Alloc, typename... Args>
+  [[nodiscard]] static void* operator new(std::size_t size, const This&, std::allocator_arg_t, const Alloc& alloc,
+                                          const Args&...)
+  {
+    return allocate_erased_frame(alloc, size);
+  }
+
+  static void operator delete(void* ptr, std::size_t size) noexcept { deallocate_erased_frame(ptr, size); }
+};
+
+}  // namespace mp_coro::detail
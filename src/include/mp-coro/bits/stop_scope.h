@@ -0,0 +1,111 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <utility>
+
+namespace mp_coro::detail {
+
+// Owns the stop source of a group of child operations. The group is stopped either explicitly
+// (i.e. on the first failure) or when the stop of the parent operation is requested.
+//
+// Creating a stop source allocates its shared state, so unless the parent can be stopped, the source is
+// created only when one of the children asks for the token (see `lazy_stop_token`). A stop requested
+// before that is remembered and applied to the source when it is created.
+class stop_scope {
+  struct forward_stop {
+    std::stop_source& source;
+    void operator()() const noexcept { source.request_stop(); }
+  };
+
+  std::stop_source source_{std::nostopstate};
+  std::atomic<bool> created_ = false;
+  std::mutex mutex_;              // guards the creation of the source
+  bool stop_requested_ = false;  // a stop requested before the source was created
+  std::stop_token parent_;
+  std::optional<std::stop_callback<forward_stop>> parent_callback_;
+public:
+  stop_scope() = default;
+
+  // only a not started scope can be moved
+  stop_scope(stop_scope&& other) noexcept : parent_(std::move(other.parent_)) {}
+
+  void set_parent(std::stop_token token) noexcept { parent_ = std::move(token); }
+
+  // Links the scope with its parent.
+  // Has to be called when the scope is already in its final location and before the children are started.
+  void start()
+  {
+    if (!parent_.stop_possible()) return;
+    source_ = std::stop_source();
+    created_.store(true, std::memory_order_relaxed);
+    parent_callback_.emplace(parent_, forward_stop{source_});
+  }
+
+  // Returns the token for the child operations (may be called concurrently by the children)
+  std::stop_token get_token()
+  {
+    if (!created_.load(std::memory_order_acquire)) {
+      std::lock_guard lock(mutex_);
+      if (!created_.load(std::memory_order_relaxed)) {
+        source_ = std::stop_source();
+        if (stop_requested_) source_.request_stop();
+        created_.store(true, std::memory_order_release);
+      }
+    }
+    return source_.get_token();
+  }
+
+  void request_stop() noexcept
+  {
+    if (!created_.load(std::memory_order_acquire)) {
+      std::lock_guard lock(mutex_);
+      if (!created_.load(std::memory_order_relaxed)) {
+        stop_requested_ = true;
+        return;
+      }
+    }
+    source_.request_stop();
+  }
+};
+
+// The stop token inherited by a coroutine. It either holds a `std::stop_token` or refers to the `stop_scope`
+// of the parent operation, so the scope creates its stop source only if the token is actually used.
+class lazy_stop_token {
+  std::stop_token token_;
+  stop_scope* scope_ = nullptr;
+public:
+  lazy_stop_token() = default;
+  lazy_stop_token(std::stop_token token) noexcept : token_(std::move(token)) {}
+  explicit lazy_stop_token(stop_scope& scope) noexcept : scope_(&scope) {}
+
+  [[nodiscard]] std::stop_token get() const { return scope_ ? scope_->get_token() : token_; }
+  operator std::stop_token() const { return get(); }
+};
+
+}  // namespace mp_coro::detail
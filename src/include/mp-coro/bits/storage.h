@@ -86,6 +86,7 @@ class storage : public storage_base<T> {
 public:
   using value_type = T;
   void set_exception(std::exception_ptr ptr) noexcept { this->result = std::move(ptr); }
+  [[nodiscard]] bool has_exception() const noexcept { return std::holds_alternative<std::exception_ptr>(this->result); }
 };
 
 }  // namespace mp_coro::detail
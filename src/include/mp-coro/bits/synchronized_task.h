@@ -23,21 +23,39 @@
 #pragma once
 
 #include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/promise_allocator.h>
+#include <mp-coro/bits/stop_scope.h>
 #include <mp-coro/bits/task_promise_storage.h>
+#include <mp-coro/cancellation.h>
 #include <mp-coro/coro_ptr.h>
 #include <mp-coro/trace.h>
 #include <mp-coro/type_traits.h>
 #include <coroutine>
+#include <memory>
+#include <utility>
 
 namespace mp_coro::detail {
 
-template<typename Sync, task_value_type T>
+// Lets `Sync` observe the failures (i.e. to stop the rest of the work) before the completion is notified
+template<typename Sync>
+void notify_completed(Sync& sync, bool failed)
+{
+  if constexpr (requires { sync.notify_awaitable_failed(); })
+    if (failed) sync.notify_awaitable_failed();
+  sync.notify_awaitable_completed();
+}
+
+template<typename Sync, task_value_type T, typename Allocator = void>
   requires requires(Sync s) { s.notify_awaitable_completed(); }
 class [[nodiscard]] synchronized_task {
 public:
   using value_type = T;
 
-  struct promise_type : private detail::noncopyable, task_promise_storage<T> {
+  struct promise_type :
+      private detail::noncopyable,
+      task_promise_storage<T>,
+      promise_allocator<Allocator>,
+      promise_stop_token {
     Sync* sync = nullptr;
 
     static std::suspend_always initial_suspend() noexcept
@@ -52,7 +70,8 @@ public:
         void await_suspend(std::coroutine_handle<promise_type> this_coro) noexcept
         {
           TRACE_FUNC();
-          this_coro.promise().sync->notify_awaitable_completed();
+          promise_type& promise = this_coro.promise();
+          notify_completed(*promise.sync, promise.has_exception());
         }
       };
       TRACE_FUNC();
@@ -70,9 +89,10 @@ public:
   synchronized_task& operator=(synchronized_task&&) = delete;
 
   // custom functions
-  void start(Sync& s)
+  void start(Sync& s, lazy_stop_token token = {})
   {
     promise_->sync = &s;
+    promise_->stop_token = std::move(token);
     std::coroutine_handle<promise_type>::from_promise(*promise_).resume();
   }
 
@@ -102,4 +122,25 @@ synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synch
   co_return co_await std::forward<A>(awaitable);
 }
 
+// Takes the ownership of an rvalue awaitable (`A` is not a reference) so the synchronized task may outlive
+// the argument of the function that created it. Lvalue awaitables are still referenced.
+template<typename Sync, typename A>
+  requires awaitable<A> && requires(Sync s) { s.notify_awaitable_completed(); }
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_owning_synchronized_task(A awaitable)
+{
+  TRACE_FUNC();
+  co_return co_await std::forward<A>(awaitable);
+}
+
+// The coroutine frame is allocated with `alloc`
+template<typename Sync, typename Alloc, awaitable A>
+  requires requires(Sync s) { s.notify_awaitable_completed(); }
+synchronized_task<Sync, remove_rvalue_reference_t<await_result_t<A>>> make_synchronized_task(std::allocator_arg_t,
+                                                                                             const Alloc&,
+                                                                                             A&& awaitable)
+{
+  TRACE_FUNC();
+  co_return co_await std::forward<A>(awaitable);
+}
+
 }  // namespace mp_coro::detail
@@ -0,0 +1,170 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <array>
+#include <bit>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace mp_coro::detail {
+
+// An intrusive node of a timer (usually stored in the awaiter of the suspended coroutine)
+struct timer_node {
+  enum class state : std::uint8_t { pending, linked, cancelled, done };
+
+  std::uint64_t expiry = 0;  // in ticks
+  timer_node* prev = nullptr;
+  timer_node* next = nullptr;
+  std::coroutine_handle<> handle;
+  std::uint16_t slot = 0;  // index of the list the timer is linked to
+  state st = state::pending;
+};
+
+// Hierarchical timer wheel (not thread-safe).
+//
+// Each of the levels has 64 slots and each slot of a level covers 64 times more ticks than a slot of the
+// previous level. A timer is inserted to the lowest level that can hold its expiry and is moved to lower
+// levels (cascaded) when the time approaches. Insertion and removal are O(1) and advancing the time
+// jumps straight to the next tick at which something may happen.
+class timer_wheel : private noncopyable {
+public:
+  static constexpr unsigned slot_bits = 6;
+  static constexpr std::size_t slots = std::size_t{1} << slot_bits;
+  static constexpr unsigned levels = 6;
+  static constexpr std::uint64_t never = std::numeric_limits<std::uint64_t>::max();
+
+  explicit timer_wheel(std::uint64_t now = 0) : now_(now)
+  {
+    for (auto& head : heads_) head.prev = head.next = &head;
+  }
+
+  [[nodiscard]] std::uint64_t now() const noexcept { return now_; }
+  [[nodiscard]] std::size_t size() const noexcept { return size_; }
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+
+  // `node.expiry` has to be in the future
+  void insert(timer_node& node) noexcept
+  {
+    assert(node.expiry > now_);
+    const std::uint64_t delta = node.expiry - now_;
+    unsigned level = 0;
+    while (level + 1 < levels && delta >> (slot_bits * (level + 1)) != 0) ++level;
+    // timers beyond the range of the wheel are parked in the last level and re-inserted when cascaded
+    const std::uint64_t range = std::uint64_t{1} << (slot_bits * levels);
+    const std::uint64_t expiry = delta < range ? node.expiry : now_ + range - 1;
+    link(node, level, static_cast<std::size_t>(expiry >> (slot_bits * level)) & (slots - 1));
+  }
+
+  void remove(timer_node& node) noexcept
+  {
+    node.prev->next = node.next;
+    node.next->prev = node.prev;
+    const std::size_t level = node.slot / slots;
+    const std::size_t index = node.slot % slots;
+    if (heads_[node.slot].next == &heads_[node.slot]) occupied_[level] &= ~(std::uint64_t{1} << index);
+    --size_;
+  }
+
+  // The nearest tick at which a timer expires or has to be cascaded
+  [[nodiscard]] std::uint64_t next_event() const noexcept
+  {
+    std::uint64_t result = never;
+    for (unsigned level = 0; level < levels; ++level) {
+      if (occupied_[level] == 0) continue;
+      const std::uint64_t base = now_ >> (slot_bits * level);
+      const auto current = static_cast<int>(base & (slots - 1));
+      const auto distance = static_cast<std::uint64_t>(std::countr_zero(std::rotr(occupied_[level], current + 1))) + 1;
+      const std::uint64_t tick = (base + distance) << (slot_bits * level);
+      if (tick < result) result = tick;
+    }
+    return result;
+  }
+
+  // Advances the time to `to` calling `on_expired(node)` for every expired (already removed) timer
+  template<typename F>
+  void advance(std::uint64_t to, F&& on_expired)
+  {
+    while (now_ < to) {
+      const std::uint64_t next = next_event();
+      if (next > to) {
+        now_ = to;
+        break;
+      }
+      now_ = next;
+      for (unsigned level = 1; level < levels && (now_ & ((std::uint64_t{1} << (slot_bits * level)) - 1)) == 0;
+           ++level)
+        cascade(level, on_expired);
+      expire(heads_[now_ & (slots - 1)], on_expired);
+    }
+  }
+
+private:
+  std::uint64_t now_;
+  std::size_t size_ = 0;
+  std::array<std::uint64_t, levels> occupied_{};  // a bitmap of non-empty slots for each level
+  std::array<timer_node, levels * slots> heads_;  // sentinels of circular lists
+
+  void link(timer_node& node, std::size_t level, std::size_t index) noexcept
+  {
+    timer_node& head = heads_[level * slots + index];
+    node.slot = static_cast<std::uint16_t>(level * slots + index);
+    node.prev = head.prev;
+    node.next = &head;
+    head.prev->next = &node;
+    head.prev = &node;
+    occupied_[level] |= std::uint64_t{1} << index;
+    ++size_;
+  }
+
+  template<typename F>
+  void expire(timer_node& head, F& on_expired)
+  {
+    while (head.next != &head) {
+      timer_node& node = *head.next;
+      remove(node);
+      on_expired(node);
+    }
+  }
+
+  template<typename F>
+  void cascade(unsigned level, F& on_expired)
+  {
+    timer_node& head = heads_[level * slots + ((now_ >> (slot_bits * level)) & (slots - 1))];
+    while (head.next != &head) {
+      timer_node& node = *head.next;
+      remove(node);
+      if (node.expiry <= now_)
+        on_expired(node);
+      else
+        insert(node);
+    }
+  }
+};
+
+}  // namespace mp_coro::detail
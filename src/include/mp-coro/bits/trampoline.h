@@ -0,0 +1,71 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <coroutine>
+
+namespace mp_coro::detail {
+
+// A coroutine waiting to be resumed by `trampoline_resume()` (usually stored in the awaiter)
+struct trampoline_node {
+  std::coroutine_handle<> handle;
+  trampoline_node* next = nullptr;
+};
+
+// Resumes the chain of coroutines from `first` to `last` on the current thread.
+//
+// Handing a resource over directly to the next waiter (i.e. `async_mutex::unlock()`) resumes it inside of
+// the call made by the previous owner. To not grow the stack with every queued waiter, the call made from
+// inside of a coroutine resumed by the trampoline only appends the chain to the thread's queue. The outermost
+// call resumes the queued coroutines one after another as soon as the current one suspends or finishes.
+inline void trampoline_resume(trampoline_node& first, trampoline_node& last) noexcept
+{
+  struct queue {
+    trampoline_node* head = nullptr;
+    trampoline_node* tail = nullptr;
+    bool active = false;
+  };
+  static constinit thread_local queue q;
+
+  last.next = nullptr;
+  if (q.tail)
+    q.tail->next = &first;
+  else
+    q.head = &first;
+  q.tail = &last;
+  if (q.active) return;
+
+  q.active = true;
+  while (trampoline_node* node = q.head) {
+    q.head = node->next;
+    if (!q.head) q.tail = nullptr;
+    // the node may be destroyed together with the awaiter as soon as the coroutine is resumed
+    node->handle.resume();
+  }
+  q.active = false;
+}
+
+inline void trampoline_resume(trampoline_node& node) noexcept { trampoline_resume(node, node); }
+
+}  // namespace mp_coro::detail
@@ -22,6 +22,8 @@
 
 #pragma once
 
+#include <type_traits>
+
 namespace mp_coro {
 
 namespace detail {
@@ -52,4 +54,10 @@ struct remove_rvalue_reference<T&&> {
 template<typename T>
 using remove_rvalue_reference_t = typename remove_rvalue_reference<T>::type;
 
+// void_type (returned in place of `void` results)
+struct void_type {};
+
+template<typename T>
+using nonvoid_t = std::conditional_t<std::is_void_v<T>, void_type, T>;
+
 }  // namespace mp_coro
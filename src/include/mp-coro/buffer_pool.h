@@ -0,0 +1,238 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/io_context.h>
+#include <mp-coro/trace.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace mp_coro {
+
+class buffer_pool;
+
+// An exclusive lease of a buffer from `buffer_pool`. The buffer returns to the pool when the lease is destroyed.
+class [[nodiscard]] buffer_lease {
+public:
+  buffer_lease(buffer_lease&& other) noexcept :
+      pool_(std::exchange(other.pool_, nullptr)), index_(other.index_)
+  {
+  }
+  buffer_lease& operator=(buffer_lease other) noexcept
+  {
+    std::swap(pool_, other.pool_);
+    std::swap(index_, other.index_);
+    return *this;
+  }
+  ~buffer_lease();
+
+  [[nodiscard]] std::span<std::byte> data() const noexcept;
+  [[nodiscard]] std::size_t index() const noexcept { return index_; }
+  [[nodiscard]] buffer_pool& pool() const noexcept { return *pool_; }
+
+private:
+  friend class buffer_pool;
+
+  buffer_pool* pool_;
+  std::size_t index_;
+
+  buffer_lease(buffer_pool& pool, std::size_t index) noexcept : pool_(&pool), index_(index) {}
+};
+
+// A fixed set of page-aligned buffers registered with the io_uring instance of `io_context`.
+//
+// Reads to the leased buffers land directly in the pre-registered memory so no allocation or page pinning
+// happens on the hot path. The buffers are suitable for `O_DIRECT` as long as their size is a multiple of
+// the logical block size of the device. If the buffers cannot be registered (i.e. `RLIMIT_MEMLOCK` is
+// too low or io_uring is not available) the pool still works but the reads use regular buffers.
+//
+// Only one pool can be registered with an `io_context` at a time. All of the leases have to be returned
+// before the pool is destroyed.
+class buffer_pool : private detail::noncopyable {
+public:
+  class [[nodiscard]] acquire_awaitable {
+  public:
+    explicit acquire_awaitable(buffer_pool& pool) noexcept : pool_(pool) {}
+
+    static bool await_ready() noexcept
+    {
+      TRACE_FUNC();
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      handle_ = handle;
+      return pool_.enqueue(*this);
+    }
+
+    buffer_lease await_resume() noexcept
+    {
+      TRACE_FUNC();
+      return {pool_, index_};
+    }
+
+  private:
+    friend class buffer_pool;
+
+    buffer_pool& pool_;
+    std::size_t index_ = 0;
+    std::coroutine_handle<> handle_;
+    acquire_awaitable* next_ = nullptr;
+  };
+
+  buffer_pool(io_context& ctx, std::size_t count, std::size_t buffer_size) :
+      ctx_(ctx), buffer_size_(round_to_page(buffer_size)), count_(count)
+  {
+    TRACE_FUNC();
+    assert(count > 0 && count <= std::numeric_limits<std::uint16_t>::max());
+    memory_ = ::mmap(nullptr, buffer_size_ * count_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory_ == MAP_FAILED) throw std::bad_alloc();
+
+    std::vector<iovec> buffers(count_);
+    free_.reserve(count_);
+    for (std::size_t i = 0; i < count_; ++i) {
+      buffers[i] = {static_cast<std::byte*>(memory_) + i * buffer_size_, buffer_size_};
+      free_.push_back(count_ - 1 - i);  // the lowest indices are leased first
+    }
+    registered_ = ctx_.register_buffers(buffers);
+  }
+
+  ~buffer_pool()
+  {
+    TRACE_FUNC();
+    assert(free_.size() == count_ && "all of the leases have to be returned before the pool is destroyed");
+    if (registered_) ctx_.unregister_buffers();
+    ::munmap(memory_, buffer_size_ * count_);
+  }
+
+  [[nodiscard]] io_context& context() const noexcept { return ctx_; }
+  [[nodiscard]] std::size_t buffer_size() const noexcept { return buffer_size_; }
+  [[nodiscard]] std::size_t size() const noexcept { return count_; }
+
+  // Returns true if the buffers are registered with io_uring
+  [[nodiscard]] bool registered() const noexcept { return registered_; }
+
+  // Suspends the awaiting coroutine until a buffer is available. Waiters are served in FIFO order.
+  [[nodiscard]] acquire_awaitable acquire() noexcept { return acquire_awaitable(*this); }
+
+  [[nodiscard]] std::optional<buffer_lease> try_acquire()
+  {
+    std::lock_guard lock(mutex_);
+    if (free_.empty()) return std::nullopt;
+    const std::size_t index = free_.back();
+    free_.pop_back();
+    return buffer_lease(*this, index);
+  }
+
+  [[nodiscard]] std::span<std::byte> buffer(std::size_t index) const noexcept
+  {
+    return {static_cast<std::byte*>(memory_) + index * buffer_size_, buffer_size_};
+  }
+
+  // Reads up to `lease.data().size()` bytes at `offset` to the leased buffer
+  [[nodiscard]] io_context::operation<std::size_t> async_read(int fd, const buffer_lease& lease, std::uint64_t offset)
+  {
+    assert(&lease.pool() == this);
+    if (registered_)
+      return ctx_.async_read_fixed(fd, lease.data(), static_cast<std::uint16_t>(lease.index()), offset);
+    return ctx_.async_read(fd, lease.data(), offset);
+  }
+
+private:
+  friend class buffer_lease;
+
+  io_context& ctx_;
+  const std::size_t buffer_size_;
+  const std::size_t count_;
+  void* memory_;
+  bool registered_ = false;
+  std::mutex mutex_;
+  std::vector<std::size_t> free_;
+  acquire_awaitable* head_ = nullptr;  // FIFO of the coroutines waiting for a buffer
+  acquire_awaitable* tail_ = nullptr;
+
+  static std::size_t round_to_page(std::size_t size)
+  {
+    const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+    return (size + page - 1) / page * page;
+  }
+
+  // Returns false if a buffer was available right away and the coroutine should not be suspended
+  bool enqueue(acquire_awaitable& waiter)
+  {
+    std::lock_guard lock(mutex_);
+    if (!free_.empty()) {
+      waiter.index_ = free_.back();
+      free_.pop_back();
+      return false;
+    }
+    if (tail_)
+      tail_->next_ = &waiter;
+    else
+      head_ = &waiter;
+    tail_ = &waiter;
+    return true;
+  }
+
+  // A released buffer is handed over directly to the first waiter (resumed on the releasing thread)
+  void release(std::size_t index)
+  {
+    acquire_awaitable* waiter = nullptr;
+    {
+      std::lock_guard lock(mutex_);
+      if (!head_) {
+        free_.push_back(index);
+        return;
+      }
+      waiter = std::exchange(head_, head_->next_);
+      if (!head_) tail_ = nullptr;
+    }
+    waiter->index_ = index;
+    waiter->handle_.resume();
+  }
+};
+
+inline buffer_lease::~buffer_lease()
+{
+  if (pool_) pool_->release(index_);
+}
+
+inline std::span<std::byte> buffer_lease::data() const noexcept { return pool_->buffer(index_); }
+
+}  // namespace mp_coro
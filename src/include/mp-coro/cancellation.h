@@ -0,0 +1,65 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/stop_scope.h>
+#include <coroutine>
+#include <stop_token>
+#include <utility>
+
+namespace mp_coro {
+
+namespace detail {
+
+struct get_stop_token_tag {};
+
+// The stop token of a coroutine. It is inherited by the coroutines and other operations it awaits for
+// (provided that they define `inherit_stop_token(awaitable, token)` found by ADL).
+struct promise_stop_token {
+  lazy_stop_token stop_token;
+
+  template<typename A>
+  A&& await_transform(A&& awaitable)
+  {
+    if constexpr (requires { inherit_stop_token(awaitable, stop_token); }) inherit_stop_token(awaitable, stop_token);
+    return std::forward<A>(awaitable);
+  }
+
+  auto await_transform(get_stop_token_tag)
+  {
+    struct awaiter : std::suspend_never {
+      std::stop_token token;
+      std::stop_token await_resume() noexcept { return std::move(token); }
+    };
+    return awaiter{{}, stop_token.get()};
+  }
+};
+
+}  // namespace detail
+
+// Returns the stop token of the current coroutine without suspending it:
+//   std::stop_token token = co_await get_stop_token();
+[[nodiscard]] constexpr detail::get_stop_token_tag get_stop_token() noexcept { return {}; }
+
+}  // namespace mp_coro
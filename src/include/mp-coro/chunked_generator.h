@@ -0,0 +1,128 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/generator.h>
+#include <mp-coro/trace.h>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <span>
+#include <utility>
+
+namespace mp_coro {
+
+// A generator producing the elements in chunks.
+//
+// The coroutine body yields `std::span<const T>` views of its internal buffer and the consumer iterates over
+// the flat range of the elements, so the coroutine is resumed once per chunk instead of once per element.
+// The chunks are also available directly with `chunks()` which lets tight loops over a chunk vectorize:
+//
+// for (std::span<const double> chunk : gen.chunks())
+//   for (double v : chunk) sum += v;
+//
+// A chunk has to stay valid until the coroutine is resumed again. Only one of the views (the flat one or
+// `chunks()`) may be used for a given generator.
+template<typename T, typename Allocator = void>
+class [[nodiscard]] chunked_generator {
+public:
+  using chunk_type = std::span<const T>;
+  using chunks_generator = generator<chunk_type, Allocator>;
+  using promise_type = typename chunks_generator::promise_type;
+  using value_type = T;
+  using reference = const T&;
+
+  class iterator {
+  public:
+    using value_type = T;
+    using difference_type = std::ptrdiff_t;
+
+    iterator() = default;  // TODO Remove when gcc is fixed
+
+    [[nodiscard]] reference operator*() const noexcept
+    {
+      assert(index_ < chunk_.size() && "Can't dereference chunked_generator end iterator");
+      return chunk_[index_];
+    }
+    [[nodiscard]] const T* operator->() const noexcept { return std::addressof(operator*()); }
+
+    iterator& operator++()
+    {
+      if (++index_ == chunk_.size()) {
+        ++it_;
+        skip_empty();
+      }
+      return *this;
+    }
+    void operator++(int) { ++*this; }
+
+    [[nodiscard]] bool operator==(std::default_sentinel_t) const noexcept { return it_ == std::default_sentinel; }
+
+    // The rest of the current chunk
+    [[nodiscard]] chunk_type chunk() const noexcept { return chunk_.subspan(index_); }
+
+  private:
+    friend chunked_generator;
+
+    typename chunks_generator::iterator it_;
+    chunk_type chunk_;
+    std::size_t index_ = 0;
+
+    explicit iterator(typename chunks_generator::iterator it) : it_(std::move(it)) { skip_empty(); }
+
+    void skip_empty()
+    {
+      while (it_ != std::default_sentinel && (*it_).empty()) ++it_;
+      chunk_ = it_ != std::default_sentinel ? *it_ : chunk_type{};
+      index_ = 0;
+    }
+  };
+  static_assert(std::input_iterator<iterator>);
+
+  chunked_generator() = default;  // TODO Remove when gcc is fixed
+  chunked_generator(chunks_generator chunks) noexcept : chunks_(std::move(chunks)) {}
+
+  [[nodiscard]] iterator begin()
+  {
+    TRACE_FUNC();
+    return iterator(chunks_.begin());
+  }
+  [[nodiscard]] std::default_sentinel_t end() const noexcept
+  {
+    TRACE_FUNC();
+    return std::default_sentinel;
+  }
+
+  // The range of the chunks as yielded by the coroutine
+  [[nodiscard]] chunks_generator& chunks() noexcept { return chunks_; }
+
+private:
+  chunks_generator chunks_;
+};
+
+}  // namespace mp_coro
+
+template<typename T, typename Allocator>
+inline constexpr bool std::ranges::enable_view<mp_coro::chunked_generator<T, Allocator>> = true;
@@ -23,33 +23,91 @@
 #pragma once
 
 #include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/promise_allocator.h>
 #include <mp-coro/coro_ptr.h>
 #include <mp-coro/trace.h>
 #include <cassert>
 #include <concepts>
 #include <coroutine>
+#include <exception>
 #include <optional>
 #include <ranges>
 #include <utility>
 
 namespace mp_coro {
 
-template<typename T>
+// `co_yield elements_of(gen)` yields all of the elements of the nested generator
+template<typename R>
+struct elements_of {
+  R range;
+};
+
+template<typename R>
+elements_of(R&&) -> elements_of<R&&>;
+
+template<typename T, typename Allocator = void>
 class [[nodiscard]] generator {
 public:
   using value_type = std::remove_reference_t<T>;
   using reference = std::conditional_t<std::is_reference_v<T>, T, const value_type&>;
   using pointer = std::add_pointer_t<reference>;
 
-  struct promise_type : private detail::noncopyable {
-    pointer value;
+  struct promise_type : private detail::noncopyable, detail::promise_allocator<Allocator> {
+    // Nested generators form a stack: every generator points to the root one (which is resumed by
+    // the iterator) and the root points to the innermost one (the leaf) so that it can be resumed directly
+    // regardless of the depth of the recursion.
+    struct nested_awaiter;
+
+    pointer value;                     // only used in the root
+    promise_type* root = this;
+    promise_type* leaf = this;         // only used in the root
+    nested_awaiter* parent = nullptr;  // `nullptr` for the root
+
+    struct final_awaiter {
+      static bool await_ready() noexcept { return false; }
+      static std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+      {
+        TRACE_FUNC();
+        promise_type& p = handle.promise();
+        if (!p.parent) return std::noop_coroutine();
+        // continue with the generator that yielded the elements of this one
+        p.root->leaf = p.parent->promise;
+        return std::coroutine_handle<promise_type>::from_promise(*p.parent->promise);
+      }
+      static void await_resume() noexcept {}
+    };
+
+    struct nested_awaiter {
+      promise_ptr<promise_type> owned{};  // empty when the elements of an lvalue generator are yielded
+      promise_type* promise = nullptr;
+      promise_type* child = nullptr;
+      std::exception_ptr exception{};
+
+      bool await_ready() const noexcept
+      {
+        return !child || std::coroutine_handle<promise_type>::from_promise(*child).done();
+      }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+      {
+        TRACE_FUNC();
+        promise = &handle.promise();
+        child->root = promise->root;
+        child->parent = this;
+        promise->root->leaf = child;
+        return std::coroutine_handle<promise_type>::from_promise(*child);
+      }
+      void await_resume()
+      {
+        if (exception) std::rethrow_exception(std::move(exception));
+      }
+    };
 
     static std::suspend_always initial_suspend() noexcept
     {
       TRACE_FUNC();
       return {};
     }
-    static std::suspend_always final_suspend() noexcept
+    static final_awaiter final_suspend() noexcept
     {
       TRACE_FUNC();
       return {};
@@ -64,13 +122,26 @@ public:
     std::suspend_always yield_value(reference v) noexcept
     {
       TRACE_FUNC();
-      value = std::addressof(v);
+      root->value = std::addressof(v);
       return {};
     }
+    nested_awaiter yield_value(elements_of<generator&&> nested) noexcept
+    {
+      TRACE_FUNC();
+      promise_type* child = nested.range.promise_.get();
+      return {.owned = std::move(nested.range.promise_), .child = child};
+    }
+    nested_awaiter yield_value(elements_of<generator&> nested) noexcept
+    {
+      TRACE_FUNC();
+      return {.child = nested.range.promise_.get()};
+    }
     void unhandled_exception()
     {
       TRACE_FUNC();
-      throw;
+      if (!parent) throw;
+      // rethrown in the body of the parent generator
+      parent->exception = std::current_exception();
     }
 
     // disallow co_await in generator coroutines
@@ -98,7 +169,7 @@ public:
     {
       TRACE_FUNC();
       assert(!handle_.done() && "Can't increment generator end iterator");
-      handle_.resume();
+      std::coroutine_handle<promise_type>::from_promise(*handle_.promise().leaf).resume();
       return *this;
     }
     void operator++(int)
@@ -152,5 +223,5 @@ private:
 
 }  // namespace mp_coro
 
-template<typename T>
-inline constexpr bool std::ranges::enable_view<mp_coro::generator<T>> = true;
+template<typename T, typename Allocator>
+inline constexpr bool std::ranges::enable_view<mp_coro::generator<T, Allocator>> = true;
@@ -0,0 +1,423 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/io_ring.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/trace.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+
+namespace mp_coro {
+
+namespace detail {
+
+// A file operation submitted to `io_context` (usually stored in the awaiter of the suspended coroutine)
+struct io_request {
+  enum class state : std::uint8_t { pending, submitted, cancel_requested, cancelled };
+
+  std::uint8_t opcode;
+  int fd;
+  void* addr = nullptr;
+  unsigned len = 0;
+  std::uint64_t offset = 0;
+  std::uint16_t buf_index = 0;  // for the operations on registered buffers
+  int flags = 0;
+  mode_t mode = 0;
+  std::string path{};
+  int result = 0;  // the number of bytes transferred, a file descriptor, or a negated `errno`
+  std::coroutine_handle<> handle{};
+  io_request* next = nullptr;
+  state st = state::pending;
+
+  // Runs the operation synchronously (used when io_uring is not available)
+  void perform() noexcept
+  {
+    ssize_t ret = -1;
+    switch (opcode) {
+      case IORING_OP_READ:
+      case IORING_OP_READ_FIXED:
+        ret = ::pread(fd, addr, len, static_cast<off_t>(offset));
+        // the offset is ignored for non-seekable files (i.e. pipes) like in io_uring
+        if (ret < 0 && errno == ESPIPE) ret = ::read(fd, addr, len);
+        break;
+      case IORING_OP_WRITE:
+        ret = ::pwrite(fd, addr, len, static_cast<off_t>(offset));
+        if (ret < 0 && errno == ESPIPE) ret = ::write(fd, addr, len);
+        break;
+      case IORING_OP_OPENAT: ret = ::openat(fd, path.c_str(), flags, mode); break;
+      default: errno = EINVAL;
+    }
+    result = ret < 0 ? -errno : static_cast<int>(ret);
+  }
+};
+
+}  // namespace detail
+
+// Asynchronous file I/O driven by io_uring.
+//
+// Operations are queued in the submission ring and handed to the kernel in batches. A dedicated thread
+// reaps the completions and resumes the awaiting coroutines directly or, if a pool is provided, on the pool's
+// threads. Submissions made by coroutines resumed on the completion thread are flushed together after the
+// whole batch of completions is processed.
+//
+// When io_uring is not available (i.e. an old kernel or a seccomp filter) the operations are performed
+// with blocking system calls on the pool (or a small internal one).
+// All operations have to complete before the context is destroyed.
+class io_context : private detail::noncopyable {
+public:
+  static constexpr unsigned default_entries = 256;
+  static constexpr std::size_t fallback_threads = 4;
+
+  template<typename T>
+  class [[nodiscard]] operation {
+  public:
+    operation(io_context& ctx, detail::io_request request) : ctx_(ctx), request_(std::move(request)) {}
+
+    // only a not awaited operation can be moved
+    operation(operation&& other) noexcept :
+        ctx_(other.ctx_), request_(std::move(other.request_)), stop_token_(std::move(other.stop_token_))
+    {
+    }
+    operation& operator=(operation&&) = delete;
+
+    static bool await_ready() noexcept
+    {
+      TRACE_FUNC();
+      return false;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      request_.handle = handle;
+      if (!ctx_.ring_) {
+        ctx_.pool_->enqueue(handle);
+        return true;
+      }
+      // a stop requested in the meantime cancels the operation
+      if (stop_token_.stop_possible()) stop_callback_.emplace(stop_token_, cancel{this});
+      return ctx_.submit(request_);
+    }
+
+    T await_resume()
+    {
+      TRACE_FUNC();
+      stop_callback_.reset();
+      if (!ctx_.ring_) {
+        if (stop_token_.stop_requested())
+          request_.result = -ECANCELED;
+        else
+          request_.perform();
+      }
+      if (request_.result < 0) throw std::system_error(-request_.result, std::system_category());
+      return static_cast<T>(request_.result);
+    }
+
+  private:
+    struct cancel {
+      operation* self;
+      void operator()() const noexcept { self->ctx_.cancel(self->request_); }
+    };
+
+    io_context& ctx_;
+    detail::io_request request_;
+    std::stop_token stop_token_;
+    std::optional<std::stop_callback<cancel>> stop_callback_;
+
+    friend void inherit_stop_token(operation& op, const std::stop_token& token) noexcept { op.stop_token_ = token; }
+  };
+
+  explicit io_context(unsigned entries = default_entries) : io_context(nullptr, entries) {}
+  explicit io_context(static_thread_pool& pool, unsigned entries = default_entries) : io_context(&pool, entries) {}
+
+  ~io_context()
+  {
+    TRACE_FUNC();
+    if (!ring_) return;
+    {
+      std::unique_lock lock(mutex_);
+      io_uring_sqe& sqe = get_sqe(lock);
+      sqe.opcode = IORING_OP_NOP;
+      sqe.user_data = stop_tag;
+      flush(lock);
+    }
+    thread_.join();
+  }
+
+  // Returns true if the operations are performed by io_uring rather than the blocking fallback
+  [[nodiscard]] bool uses_io_uring() const noexcept { return static_cast<bool>(ring_); }
+
+  // Reads up to `buffer.size()` bytes at `offset` and returns the number of bytes read
+  [[nodiscard]] operation<std::size_t> async_read(int fd, std::span<std::byte> buffer, std::uint64_t offset)
+  {
+    return {*this,
+            {.opcode = IORING_OP_READ, .fd = fd, .addr = buffer.data(), .len = clamp(buffer.size()), .offset = offset}};
+  }
+
+  // Writes up to `buffer.size()` bytes at `offset` and returns the number of bytes written
+  [[nodiscard]] operation<std::size_t> async_write(int fd, std::span<const std::byte> buffer, std::uint64_t offset)
+  {
+    return {*this,
+            {.opcode = IORING_OP_WRITE,
+             .fd = fd,
+             .addr = const_cast<std::byte*>(buffer.data()),
+             .len = clamp(buffer.size()),
+             .offset = offset}};
+  }
+
+  // Reads to the buffer registered at `buffer_index` (see `buffer_pool`)
+  [[nodiscard]] operation<std::size_t> async_read_fixed(int fd, std::span<std::byte> buffer, std::uint16_t buffer_index,
+                                                        std::uint64_t offset)
+  {
+    return {*this,
+            {.opcode = IORING_OP_READ_FIXED,
+             .fd = fd,
+             .addr = buffer.data(),
+             .len = clamp(buffer.size()),
+             .offset = offset,
+             .buf_index = buffer_index}};
+  }
+
+  // Opens the file with the `open()` flags and returns its descriptor
+  [[nodiscard]] operation<int> async_open(const std::filesystem::path& path, int flags, mode_t mode = 0)
+  {
+    return {*this,
+            {.opcode = IORING_OP_OPENAT,
+             .fd = AT_FDCWD,
+             .flags = flags | O_CLOEXEC,
+             .mode = mode,
+             .path = path.native()}};
+  }
+
+private:
+  friend class buffer_pool;
+
+  static constexpr std::uint64_t cancel_tag = 0;
+  static constexpr std::uint64_t stop_tag = 1;
+
+  std::optional<static_thread_pool> fallback_pool_;
+  static_thread_pool* pool_;
+  std::unique_ptr<detail::io_ring> ring_;
+  std::mutex mutex_;  // guards the submission queue and the states of the requests
+  std::jthread thread_;
+  // used only by the completion thread; completed requests are chained with their `next` pointers
+  detail::io_request* completed_ = nullptr;
+  detail::io_request** completed_last_ = &completed_;
+  bool stop_ = false;
+
+  io_context(static_thread_pool* pool, unsigned entries) : pool_(pool)
+  {
+    TRACE_FUNC();
+    try {
+      ring_ = std::make_unique<detail::io_ring>(entries);
+    } catch (const std::system_error&) {
+      if (!pool_) pool_ = &fallback_pool_.emplace(fallback_threads);
+      return;
+    }
+    thread_ = std::jthread([this] { run(); });
+  }
+
+  static unsigned clamp(std::size_t size)
+  {
+    return static_cast<unsigned>(std::min<std::size_t>(size, std::numeric_limits<unsigned>::max()));
+  }
+
+  io_uring_sqe& get_sqe(std::unique_lock<std::mutex>& lock)
+  {
+    while (true) {
+      if (io_uring_sqe* sqe = ring_->get_sqe()) return *sqe;
+      flush(lock);
+    }
+  }
+
+  // Hands all of the queued entries over to the kernel. A refused submission is never left behind, as nothing
+  // would flush it if no other request is in flight.
+  void flush(std::unique_lock<std::mutex>& lock)
+  {
+    while (!ring_->submit()) {
+      // the kernel is out of resources until some of the completions are reaped
+      if (!on_completion_thread()) {
+        lock.unlock();
+        std::this_thread::yield();
+        lock.lock();
+      } else if (reap_completions() == 0) {
+        // nobody else reaps them; nothing to reap means the kernel is short of memory
+        lock.unlock();
+        detail::io_ring::back_off();
+        lock.lock();
+      }
+    }
+  }
+
+  // Returns false if the buffers cannot be used with `async_read_fixed()`
+  bool register_buffers(std::span<const iovec> buffers)
+  {
+    if (!ring_) return false;
+    std::lock_guard lock(mutex_);
+    return ring_->register_buffers(buffers.data(), static_cast<unsigned>(buffers.size()));
+  }
+
+  void unregister_buffers()
+  {
+    std::lock_guard lock(mutex_);
+    ring_->unregister_buffers();
+  }
+
+  bool on_completion_thread() const noexcept { return std::this_thread::get_id() == thread_.get_id(); }
+
+  // Returns false if the coroutine should not be suspended (the request was cancelled before the submission)
+  bool submit(detail::io_request& request)
+  {
+    std::unique_lock lock(mutex_);
+    if (request.st == detail::io_request::state::cancelled) {
+      request.result = -ECANCELED;
+      return false;
+    }
+    io_uring_sqe& sqe = get_sqe(lock);
+    sqe.opcode = request.opcode;
+    sqe.fd = request.fd;
+    sqe.off = request.offset;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(request.opcode == IORING_OP_OPENAT ? request.path.c_str()
+                                                                                     : request.addr);
+    sqe.len = request.len;
+    sqe.buf_index = request.buf_index;
+    sqe.open_flags = static_cast<__u32>(request.flags);
+    if (request.opcode == IORING_OP_OPENAT) sqe.len = request.mode;
+    sqe.user_data = reinterpret_cast<std::uintptr_t>(&request);
+    request.st = detail::io_request::state::submitted;
+    // the completion thread flushes the whole batch when it is done with the current completions
+    if (!on_completion_thread()) flush(lock);
+    return true;
+  }
+
+  void cancel(detail::io_request& request)
+  {
+    std::unique_lock lock(mutex_);
+    if (request.st == detail::io_request::state::pending) {
+      request.st = detail::io_request::state::cancelled;
+      return;
+    }
+    if (request.st != detail::io_request::state::submitted) return;
+    request.st = detail::io_request::state::cancel_requested;
+    io_uring_sqe& sqe = get_sqe(lock);
+    sqe.opcode = IORING_OP_ASYNC_CANCEL;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(&request);
+    sqe.user_data = cancel_tag;
+    // submitted right away as the request may be reused as soon as this call returns
+    flush(lock);
+  }
+
+  // Appends the available completions to the `completed_` chain (called with the mutex locked)
+  unsigned reap_completions()
+  {
+    return ring_->reap([&](const io_uring_cqe& cqe) {
+      if (cqe.user_data == cancel_tag) return;
+      if (cqe.user_data == stop_tag) {
+        stop_ = true;
+        return;
+      }
+      auto& request = *reinterpret_cast<detail::io_request*>(cqe.user_data);
+      request.result = cqe.res;
+      request.next = nullptr;
+      *completed_last_ = &request;
+      completed_last_ = &request.next;
+    });
+  }
+
+  void run()
+  {
+    TRACE_FUNC();
+    while (!stop_) {
+      // completions reaped while the previous batch was submitted are already waiting
+      if (!completed_) ring_->wait();
+
+      detail::io_request* first = nullptr;
+      {
+        std::lock_guard lock(mutex_);
+        reap_completions();
+        first = std::exchange(completed_, nullptr);
+        completed_last_ = &completed_;
+      }
+      while (first) {
+        // the request may be destroyed as soon as its coroutine is resumed
+        auto handle = first->handle;
+        first = first->next;
+        if (pool_)
+          pool_->enqueue(handle);
+        else
+          handle.resume();
+      }
+
+      // submissions of the resumed coroutines
+      std::unique_lock lock(mutex_);
+      flush(lock);
+    }
+  }
+};
+
+// A lazily created I/O context resuming the coroutines on its completion thread
+[[nodiscard]] inline io_context& default_io_context()
+{
+  static io_context ctx;
+  return ctx;
+}
+
+[[nodiscard]] inline io_context::operation<std::size_t> async_read(int fd, std::span<std::byte> buffer,
+                                                                    std::uint64_t offset)
+{
+  return default_io_context().async_read(fd, buffer, offset);
+}
+
+[[nodiscard]] inline io_context::operation<std::size_t> async_write(int fd, std::span<const std::byte> buffer,
+                                                                     std::uint64_t offset)
+{
+  return default_io_context().async_write(fd, buffer, offset);
+}
+
+[[nodiscard]] inline io_context::operation<int> async_open(const std::filesystem::path& path, int flags,
+                                                           mode_t mode = 0)
+{
+  return default_io_context().async_open(path, flags, mode);
+}
+
+}  // namespace mp_coro
@@ -0,0 +1,339 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/trace.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace mp_coro {
+
+class reactor;
+
+namespace detail {
+
+// An operation waiting for the readiness of a file descriptor (usually stored in the awaiter of the suspended
+// coroutine). `perform()` runs the non-blocking system call and returns false if it would block.
+class reactor_op {
+public:
+  enum class direction : std::uint8_t { read, write };
+  enum class state : std::uint8_t { pending, armed, cancelled, done };
+  using perform_func = bool (*)(reactor_op&) noexcept;
+
+  std::coroutine_handle<> handle;
+  reactor_op* next = nullptr;
+  std::ptrdiff_t result = 0;  // the result of the system call or a negated `errno`
+  state st = state::pending;
+  direction dir;
+
+  bool perform() noexcept { return perform_(*this); }
+
+protected:
+  reactor_op(direction d, perform_func func) noexcept : dir(d), perform_(func) {}
+
+  // `Op::try_perform()` as `perform_func`
+  template<typename Op>
+  static bool perform_as(reactor_op& op) noexcept
+  {
+    return static_cast<Op&>(op).try_perform();
+  }
+
+  // Stores the result of a system call. Returns false if it would block.
+  bool complete(std::ptrdiff_t ret) noexcept
+  {
+    if (ret < 0 && errno == EAGAIN) return false;
+    result = ret < 0 ? -errno : ret;
+    return true;
+  }
+
+private:
+  perform_func perform_;
+};
+
+// A file descriptor registered with the reactor with at most one pending operation in each direction.
+// Destroyed by the reactor thread as it may still hold a stale event for the descriptor.
+struct reactor_socket {
+  reactor& owner;
+  int fd;
+  std::mutex mutex;
+  std::array<reactor_op*, 2> ops{};
+  bool registered = false;
+  bool closed = false;
+  reactor_socket* prev = nullptr;  // the list of the sockets of the reactor
+  reactor_socket* next = nullptr;
+  reactor_socket* next_retired = nullptr;
+
+  reactor_socket(reactor& r, int f) noexcept : owner(r), fd(f) {}
+};
+
+}  // namespace detail
+
+// Edge-triggered epoll reactor driving the socket operations with a dedicated thread.
+//
+// A descriptor is armed with `EPOLLONESHOT` only when an operation would block and is re-armed as long as
+// it has pending operations. The operations are performed on the reactor thread as soon as the descriptor
+// becomes ready and the awaiting coroutines are resumed there or, if a pool is provided, on the pool's threads.
+// If waiting for the events fails, the pending and all of the future operations fail with its error.
+// All of the sockets have to be destroyed before the reactor.
+class reactor : private detail::noncopyable {
+public:
+  reactor() : reactor(nullptr) {}
+  explicit reactor(static_thread_pool& pool) : reactor(&pool) {}
+
+  ~reactor()
+  {
+    TRACE_FUNC();
+    const std::uint64_t value = 1;
+    [[maybe_unused]] const auto ret = ::write(wake_fd_, &value, sizeof(value));
+    thread_.join();
+    free_retired();
+    ::close(wake_fd_);
+    ::close(epoll_fd_);
+  }
+
+  // Creates the state of a socket owning the descriptor (released with `retire()`)
+  detail::reactor_socket* attach(int fd)
+  {
+    auto* socket = new detail::reactor_socket(*this, fd);
+    std::lock_guard lock(mutex_);
+    socket->next = std::exchange(sockets_, socket);
+    if (socket->next) socket->next->prev = socket;
+    return socket;
+  }
+
+  // Arms the descriptor for the operation that would block.
+  // Returns false if the coroutine should not be suspended (the operation was cancelled in the meantime).
+  bool arm(detail::reactor_socket& socket, detail::reactor_op& op)
+  {
+    std::lock_guard lock(socket.mutex);
+    if (op.st == detail::reactor_op::state::cancelled) {
+      op.result = -ECANCELED;
+      return false;
+    }
+    if (const int error = error_.load(std::memory_order_relaxed)) {
+      op.result = -error;
+      return false;
+    }
+    auto& slot = socket.ops[static_cast<std::size_t>(op.dir)];
+    assert(!slot && "only one operation in each direction may be pending for a socket");
+    slot = &op;
+    op.st = detail::reactor_op::state::armed;
+    update_interest(socket);
+    return true;
+  }
+
+  void cancel(detail::reactor_socket& socket, detail::reactor_op& op)
+  {
+    {
+      std::lock_guard lock(socket.mutex);
+      if (op.st == detail::reactor_op::state::pending) {
+        op.st = detail::reactor_op::state::cancelled;
+        return;
+      }
+      auto& slot = socket.ops[static_cast<std::size_t>(op.dir)];
+      if (slot != &op) return;
+      slot = nullptr;
+      op.st = detail::reactor_op::state::done;
+      op.result = -ECANCELED;
+      update_interest(socket);
+    }
+    resume(op.handle);
+  }
+
+  // Closes the descriptor and hands the socket over to the reactor thread to be destroyed
+  void retire(detail::reactor_socket* socket)
+  {
+    {
+      std::lock_guard lock(socket->mutex);
+      assert(!socket->ops[0] && !socket->ops[1] && "a socket cannot be destroyed with pending operations");
+      socket->closed = true;
+      if (socket->registered) ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, socket->fd, nullptr);
+      ::close(socket->fd);
+    }
+    std::lock_guard lock(mutex_);
+    if (socket->prev)
+      socket->prev->next = socket->next;
+    else
+      sockets_ = socket->next;
+    if (socket->next) socket->next->prev = socket->prev;
+    socket->next_retired = retired_;
+    retired_ = socket;
+  }
+
+private:
+  static constexpr int max_events = 256;
+
+  static_thread_pool* pool_;
+  int epoll_fd_;
+  int wake_fd_;
+  std::mutex mutex_;  // guards the lists of the sockets
+  detail::reactor_socket* sockets_ = nullptr;
+  detail::reactor_socket* retired_ = nullptr;
+  std::atomic<int> error_ = 0;  // set when the reactor thread cannot wait for the events anymore
+  std::thread thread_;
+
+  explicit reactor(static_thread_pool* pool) : pool_(pool)
+  {
+    TRACE_FUNC();
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd_ < 0) throw std::system_error(errno, std::system_category(), "epoll_create1");
+    wake_fd_ = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (wake_fd_ < 0) {
+      const int error = errno;
+      ::close(epoll_fd_);
+      throw std::system_error(error, std::system_category(), "eventfd");
+    }
+    epoll_event event{.events = EPOLLIN, .data = {.ptr = nullptr}};
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &event);
+    thread_ = std::thread([this] { run(); });
+  }
+
+  void resume(std::coroutine_handle<> handle)
+  {
+    if (pool_)
+      pool_->enqueue(handle);
+    else
+      handle.resume();
+  }
+
+  // Has to be called with the socket's mutex locked
+  void update_interest(detail::reactor_socket& socket)
+  {
+    std::uint32_t events = EPOLLET | EPOLLONESHOT;
+    if (socket.ops[0]) events |= EPOLLIN | EPOLLRDHUP;
+    if (socket.ops[1]) events |= EPOLLOUT;
+    epoll_event event{.events = events, .data = {.ptr = &socket}};
+    if (socket.registered)
+      ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, socket.fd, &event);
+    else if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, socket.fd, &event) == 0)
+      socket.registered = true;
+  }
+
+  void process(detail::reactor_socket& socket, std::uint32_t events)
+  {
+    // completed operations are chained with their `next` pointers
+    detail::reactor_op* first = nullptr;
+    detail::reactor_op** last = &first;
+    {
+      std::lock_guard lock(socket.mutex);
+      if (socket.closed) return;
+      const bool failed = events & (EPOLLERR | EPOLLHUP);
+      const std::array<bool, 2> ready = {failed || (events & (EPOLLIN | EPOLLRDHUP)), failed || (events & EPOLLOUT)};
+      for (std::size_t i = 0; i < socket.ops.size(); ++i) {
+        detail::reactor_op* op = socket.ops[i];
+        if (!op || !ready[i] || !op->perform()) continue;
+        socket.ops[i] = nullptr;
+        op->st = detail::reactor_op::state::done;
+        op->next = nullptr;
+        *last = op;
+        last = &op->next;
+      }
+      // the one-shot registration is re-armed for the operations that are still pending
+      if (socket.ops[0] || socket.ops[1]) update_interest(socket);
+    }
+    while (first) {
+      // the operation may be destroyed as soon as its coroutine is resumed
+      auto handle = first->handle;
+      first = first->next;
+      resume(handle);
+    }
+  }
+
+  // Completes all of the armed operations with `error` (the socket mutexes make the error visible to `arm()`)
+  void fail_all(int error)
+  {
+    error_.store(error, std::memory_order_relaxed);
+    detail::reactor_op* first = nullptr;
+    detail::reactor_op** last = &first;
+    {
+      std::lock_guard lock(mutex_);
+      for (detail::reactor_socket* socket = sockets_; socket; socket = socket->next) {
+        std::lock_guard socket_lock(socket->mutex);
+        for (detail::reactor_op*& op : socket->ops) {
+          if (!op) continue;
+          op->st = detail::reactor_op::state::done;
+          op->result = -error;
+          op->next = nullptr;
+          *last = std::exchange(op, nullptr);
+          last = &(*last)->next;
+        }
+      }
+    }
+    while (first) {
+      auto handle = first->handle;
+      first = first->next;
+      resume(handle);
+    }
+  }
+
+  void free_retired()
+  {
+    detail::reactor_socket* socket = nullptr;
+    {
+      std::lock_guard lock(mutex_);
+      socket = std::exchange(retired_, nullptr);
+    }
+    while (socket) delete std::exchange(socket, socket->next_retired);
+  }
+
+  void run()
+  {
+    TRACE_FUNC();
+    std::array<epoll_event, max_events> events;
+    bool stop = false;
+    while (!stop) {
+      const int count = ::epoll_wait(epoll_fd_, events.data(), max_events, -1);
+      if (count < 0) {
+        if (errno == EINTR) continue;
+        // an exception would terminate the program so the awaiting coroutines get the error instead
+        fail_all(errno);
+        return;
+      }
+      for (int i = 0; i < count; ++i) {
+        if (events[static_cast<std::size_t>(i)].data.ptr)
+          process(*static_cast<detail::reactor_socket*>(events[static_cast<std::size_t>(i)].data.ptr),
+                  events[static_cast<std::size_t>(i)].events);
+        else
+          stop = true;
+      }
+      // none of the events received from now on can refer to the sockets retired so far
+      free_retired();
+    }
+  }
+};
+
+}  // namespace mp_coro
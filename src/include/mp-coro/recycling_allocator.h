@@ -0,0 +1,58 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/frame_pool.h>
+#include <cstddef>
+
+namespace mp_coro {
+
+// A stateless allocator that recycles memory blocks with thread-local size-class free lists.
+//
+// Intended for coroutine frames (i.e. `task<T, recycling_allocator<>>`) where after a warm-up
+// the creation of a coroutine does not call the system allocator at all. Blocks can be released
+// on any thread.
+template<typename T = std::byte>
+class recycling_allocator {
+public:
+  static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__, "Over-aligned types are not supported");
+  using value_type = T;
+
+  recycling_allocator() = default;
+  template<typename U>
+  constexpr recycling_allocator(const recycling_allocator<U>&) noexcept
+  {
+  }
+
+  [[nodiscard]] T* allocate(std::size_t n) { return static_cast<T*>(detail::frame_pool::allocate(n * sizeof(T))); }
+  void deallocate(T* ptr, std::size_t) noexcept { detail::frame_pool::deallocate(ptr); }
+
+  template<typename U>
+  [[nodiscard]] friend constexpr bool operator==(const recycling_allocator&, const recycling_allocator<U>&) noexcept
+  {
+    return true;
+  }
+};
+
+}  // namespace mp_coro
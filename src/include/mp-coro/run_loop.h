@@ -0,0 +1,217 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/synchronized_task.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/trace.h>
+#include <mp-coro/type_traits.h>
+#include <atomic>
+#include <coroutine>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace mp_coro {
+
+// A queue of coroutines resumed by the thread calling `run()` (or `sync_await(loop, awaitable)`).
+//
+// Coroutines scheduled from the thread running the loop are appended to a local intrusive FIFO without any
+// synchronization. The ones scheduled from other threads are pushed to a lock-free stack that is moved to the
+// local queue when it runs empty. The scheduling does not allocate as the nodes are stored in the awaiters.
+class run_loop : private detail::noncopyable {
+  struct node {
+    node* next = nullptr;
+    std::coroutine_handle<> handle;
+  };
+
+public:
+  [[nodiscard]] awaiter_of<void> auto schedule() noexcept
+  {
+    struct schedule_awaiter {
+      run_loop& loop;
+      node n;
+
+      static bool await_ready() noexcept
+      {
+        TRACE_FUNC();
+        return false;
+      }
+      void await_suspend(std::coroutine_handle<> handle) noexcept
+      {
+        TRACE_FUNC();
+        n.handle = handle;
+        loop.enqueue(n);
+      }
+      static void await_resume() noexcept { TRACE_FUNC(); }
+    };
+    TRACE_FUNC();
+    return schedule_awaiter{*this, {}};
+  }
+
+  // Runs the scheduled coroutines on the calling thread until `finish()` is called
+  void run()
+  {
+    TRACE_FUNC();
+    run_until([&] { return finished_.load(std::memory_order_acquire); });
+    finished_.store(false, std::memory_order_relaxed);
+  }
+
+  // Makes `run()` return as soon as the coroutine currently being resumed suspends (may be called from any thread)
+  void finish() noexcept
+  {
+    finished_.store(true, std::memory_order_release);
+    wake();
+  }
+
+private:
+  template<awaitable A>
+  friend remove_rvalue_reference_t<await_result_t<A>> sync_await(run_loop& loop, std::stop_token token,
+                                                                   A&& awaitable);
+
+  inline static thread_local run_loop* current_loop_ = nullptr;
+
+  node* head_ = nullptr;  // the local queue accessed only by the thread running the loop
+  node* tail_ = nullptr;
+  std::atomic<node*> remote_ = nullptr;  // LIFO of the coroutines scheduled by other threads
+  std::atomic<unsigned> epoch_ = 0;
+  std::atomic<bool> sleeping_ = false;
+  std::atomic<bool> finished_ = false;
+
+  void push_local(node& n) noexcept
+  {
+    n.next = nullptr;
+    if (tail_)
+      tail_->next = &n;
+    else
+      head_ = &n;
+    tail_ = &n;
+  }
+
+  void enqueue(node& n) noexcept
+  {
+    if (current_loop_ == this) {
+      push_local(n);
+      return;
+    }
+    n.next = remote_.load(std::memory_order_relaxed);
+    while (!remote_.compare_exchange_weak(n.next, &n, std::memory_order_release, std::memory_order_relaxed)) {
+    }
+    wake();
+  }
+
+  void wake() noexcept
+  {
+    // The `seq_cst` ordering pairs with the one in `run_until()` so that either the loop going to sleep observes
+    // a new epoch or the producer observes the sleeping loop and wakes it up.
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst)) epoch_.notify_one();
+  }
+
+  // Moves the coroutines scheduled by other threads to the local queue (restoring their FIFO order)
+  bool take_remote() noexcept
+  {
+    node* n = remote_.exchange(nullptr, std::memory_order_acquire);
+    if (!n) return false;
+    node* reversed = nullptr;
+    while (n) {
+      node* next = n->next;
+      n->next = reversed;
+      reversed = n;
+      n = next;
+    }
+    while (reversed) push_local(*std::exchange(reversed, reversed->next));
+    return true;
+  }
+
+  // Returns as soon as `done()` is true. The coroutines that are still queued are resumed by the next run.
+  template<typename Done>
+  void run_until(Done done)
+  {
+    run_loop* const previous = std::exchange(current_loop_, this);
+    while (!done()) {
+      if (head_ || take_remote()) {
+        node& n = *std::exchange(head_, head_->next);
+        if (!head_) tail_ = nullptr;
+        // the node is destroyed as soon as its coroutine is resumed
+        n.handle.resume();
+        continue;
+      }
+
+      sleeping_.store(true, std::memory_order_seq_cst);
+      const auto epoch = epoch_.load(std::memory_order_seq_cst);
+      if (!done() && !remote_.load(std::memory_order_acquire))
+        epoch_.wait(epoch, std::memory_order_seq_cst);
+      sleeping_.store(false, std::memory_order_relaxed);
+    }
+    current_loop_ = previous;
+  }
+};
+
+// Starts the awaitable on the calling thread and runs the coroutines scheduled on `loop` until the result is
+// ready. The awaitable inherits `token` and may use it to stop the work before its completion.
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<await_result_t<A>> sync_await(run_loop& loop, std::stop_token token,
+                                                                      A&& awaitable)
+{
+  struct sync {
+    enum class state { running, done, notifying };
+    run_loop& loop;
+    std::atomic<state> st = state::running;
+    void notify_awaitable_completed()
+    {
+      if (run_loop::current_loop_ == &loop) {
+        st.store(state::done, std::memory_order_release);
+        return;
+      }
+      // the loop has to be woken up and `sync_await` may not return before that is finished
+      st.store(state::notifying, std::memory_order_release);
+      loop.wake();
+      st.store(state::done, std::memory_order_release);
+    }
+  };
+
+  TRACE_FUNC();
+  auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
+  sync work_done{loop};
+  {
+    // the coroutines scheduled by the awaitable before its first suspension go to the local queue
+    run_loop* const previous = std::exchange(run_loop::current_loop_, &loop);
+    sync_task.start(work_done, std::move(token));
+    run_loop::current_loop_ = previous;
+  }
+  loop.run_until([&] { return work_done.st.load(std::memory_order_acquire) != sync::state::running; });
+  while (work_done.st.load(std::memory_order_acquire) == sync::state::notifying) std::this_thread::yield();
+  return std::move(sync_task).get();
+}
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<await_result_t<A>> sync_await(run_loop& loop, A&& awaitable)
+{
+  TRACE_FUNC();
+  return sync_await(loop, std::stop_token(), std::forward<A>(awaitable));
+}
+
+}  // namespace mp_coro
@@ -0,0 +1,305 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/reactor.h>
+#include <mp-coro/trace.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace mp_coro {
+
+// An IPv4 or Unix domain socket address
+class endpoint {
+  sockaddr_storage storage_{};
+  socklen_t size_ = 0;
+public:
+  endpoint() = default;
+  endpoint(const sockaddr* addr, socklen_t size) : size_(size) { std::memcpy(&storage_, addr, size); }
+
+  [[nodiscard]] static endpoint ipv4(const char* address, std::uint16_t port)
+  {
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (::inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument), "endpoint::ipv4");
+    return endpoint(reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+  }
+
+  // 127.0.0.1:port (port 0 picks an ephemeral port when listening)
+  [[nodiscard]] static endpoint loopback(std::uint16_t port) { return ipv4("127.0.0.1", port); }
+
+  [[nodiscard]] static endpoint unix_domain(std::string_view path)
+  {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+      throw std::system_error(std::make_error_code(std::errc::filename_too_long), "endpoint::unix_domain");
+    path.copy(addr.sun_path, path.size());
+    return endpoint(reinterpret_cast<const sockaddr*>(&addr),
+                    static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size() + 1));
+  }
+
+  [[nodiscard]] int family() const noexcept { return storage_.ss_family; }
+  [[nodiscard]] const sockaddr* data() const noexcept { return reinterpret_cast<const sockaddr*>(&storage_); }
+  [[nodiscard]] socklen_t size() const noexcept { return size_; }
+
+  // The port of an IPv4 endpoint
+  [[nodiscard]] std::uint16_t port() const noexcept
+  {
+    return family() == AF_INET ? ntohs(reinterpret_cast<const sockaddr_in*>(&storage_)->sin_port) : 0;
+  }
+};
+
+namespace detail {
+
+struct recv_op : reactor_op {
+  int fd;
+  std::span<std::byte> buffer;
+  recv_op(reactor_socket& s, std::span<std::byte> b) noexcept :
+      reactor_op(direction::read, perform_as<recv_op>), fd(s.fd), buffer(b)
+  {
+  }
+  bool try_perform() noexcept { return complete(::recv(fd, buffer.data(), buffer.size(), 0)); }
+  std::size_t get() const noexcept { return static_cast<std::size_t>(result); }
+};
+
+struct send_op : reactor_op {
+  int fd;
+  std::span<const std::byte> buffer;
+  send_op(reactor_socket& s, std::span<const std::byte> b) noexcept :
+      reactor_op(direction::write, perform_as<send_op>), fd(s.fd), buffer(b)
+  {
+  }
+  bool try_perform() noexcept { return complete(::send(fd, buffer.data(), buffer.size(), MSG_NOSIGNAL)); }
+  std::size_t get() const noexcept { return static_cast<std::size_t>(result); }
+};
+
+struct connect_op : reactor_op {
+  int fd;
+  endpoint peer;
+  bool started = false;
+  connect_op(reactor_socket& s, const endpoint& p) noexcept :
+      reactor_op(direction::write, perform_as<connect_op>), fd(s.fd), peer(p)
+  {
+  }
+  bool try_perform() noexcept
+  {
+    if (!started) {
+      if (::connect(fd, peer.data(), peer.size()) == 0) return complete(0);
+      // the backlog of an AF_UNIX listener is full; no readiness event tells when it is not, so it is up
+      // to the caller to retry
+      if (errno == EAGAIN) {
+        result = -EAGAIN;
+        return true;
+      }
+      started = true;
+      if (errno != EINPROGRESS) return complete(-1);
+      return false;
+    }
+    // the descriptor became writable so the result of the connection is known
+    int error = 0;
+    socklen_t size = sizeof(error);
+    if (::getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &size) < 0) return complete(-1);
+    result = -error;
+    return true;
+  }
+  static void get() noexcept {}
+};
+
+// Performs the operation right away and suspends the awaiting coroutine only if it would block
+template<typename Op, typename T>
+class socket_awaitable {
+public:
+  template<typename... Args>
+  explicit socket_awaitable(reactor_socket& socket, Args&&... args) :
+      socket_(socket), op_(socket, std::forward<Args>(args)...)
+  {
+  }
+
+  // only a not awaited operation can be moved
+  socket_awaitable(socket_awaitable&& other) noexcept :
+      socket_(other.socket_), op_(other.op_), stop_token_(std::move(other.stop_token_))
+  {
+  }
+  socket_awaitable& operator=(socket_awaitable&&) = delete;
+
+  bool await_ready()
+  {
+    TRACE_FUNC();
+    return !stop_token_.stop_requested() && op_.perform();
+  }
+
+  bool await_suspend(std::coroutine_handle<> handle)
+  {
+    TRACE_FUNC();
+    op_.handle = handle;
+    // a stop requested in the meantime cancels the operation
+    if (stop_token_.stop_possible()) stop_callback_.emplace(stop_token_, cancel{this});
+    return socket_.owner.arm(socket_, op_);
+  }
+
+  T await_resume()
+  {
+    TRACE_FUNC();
+    stop_callback_.reset();
+    if (op_.result < 0) throw std::system_error(static_cast<int>(-op_.result), std::system_category());
+    return static_cast<T>(op_.get());
+  }
+
+private:
+  struct cancel {
+    socket_awaitable* self;
+    void operator()() const noexcept { self->socket_.owner.cancel(self->socket_, self->op_); }
+  };
+
+  reactor_socket& socket_;
+  Op op_;
+  std::stop_token stop_token_;
+  std::optional<std::stop_callback<cancel>> stop_callback_;
+
+  friend void inherit_stop_token(socket_awaitable& awaitable, const std::stop_token& token) noexcept
+  {
+    awaitable.stop_token_ = token;
+  }
+};
+
+}  // namespace detail
+
+// A non-blocking stream socket (TCP or Unix domain) driven by a `reactor`.
+//
+// At most one receiving (or accepting) and one sending (or connecting) operation may be pending at a time.
+// Errors are reported with `std::system_error` and a stop requested for the awaiting coroutine cancels the
+// pending operation.
+class async_socket {
+  struct accept_op;
+public:
+  // Takes the ownership of a socket descriptor
+  async_socket(reactor& r, int fd) : socket_(r.attach(fd))
+  {
+    const int flags = ::fcntl(fd, F_GETFL);
+    if (flags >= 0 && !(flags & O_NONBLOCK)) ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+  }
+  async_socket(async_socket&& other) noexcept : socket_(std::exchange(other.socket_, nullptr)) {}
+  async_socket& operator=(async_socket other) noexcept
+  {
+    std::swap(socket_, other.socket_);
+    return *this;
+  }
+  ~async_socket()
+  {
+    if (socket_) socket_->owner.retire(socket_);
+  }
+
+  // Creates a not connected stream socket for the address family of `peer`
+  [[nodiscard]] static async_socket open(reactor& r, const endpoint& peer)
+  {
+    const int fd = ::socket(peer.family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) throw std::system_error(errno, std::system_category(), "socket");
+    return async_socket(r, fd);
+  }
+
+  // Creates a socket listening on `local` (an existing Unix domain socket file is not removed)
+  [[nodiscard]] static async_socket listen(reactor& r, const endpoint& local, int backlog = SOMAXCONN)
+  {
+    async_socket s = open(r, local);
+    if (local.family() != AF_UNIX) {
+      const int on = 1;
+      ::setsockopt(s.native_handle(), SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    }
+    if (::bind(s.native_handle(), local.data(), local.size()) < 0)
+      throw std::system_error(errno, std::system_category(), "bind");
+    if (::listen(s.native_handle(), backlog) < 0) throw std::system_error(errno, std::system_category(), "listen");
+    return s;
+  }
+
+  [[nodiscard]] int native_handle() const noexcept { return socket_->fd; }
+
+  [[nodiscard]] endpoint local_endpoint() const
+  {
+    sockaddr_storage addr{};
+    socklen_t size = sizeof(addr);
+    if (::getsockname(native_handle(), reinterpret_cast<sockaddr*>(&addr), &size) < 0)
+      throw std::system_error(errno, std::system_category(), "getsockname");
+    return endpoint(reinterpret_cast<const sockaddr*>(&addr), size);
+  }
+
+  // Shuts down the sending side so the peer receives the end of the stream
+  void shutdown_send() { ::shutdown(native_handle(), SHUT_WR); }
+
+  [[nodiscard]] auto async_accept() { return detail::socket_awaitable<accept_op, async_socket>(*socket_); }
+
+  // Fails with `EAGAIN` if the backlog of a Unix domain listener is full (the connection may be retried later)
+  [[nodiscard]] auto async_connect(const endpoint& peer)
+  {
+    return detail::socket_awaitable<detail::connect_op, void>(*socket_, peer);
+  }
+
+  // Returns the number of bytes received (0 at the end of the stream)
+  [[nodiscard]] auto async_recv(std::span<std::byte> buffer)
+  {
+    return detail::socket_awaitable<detail::recv_op, std::size_t>(*socket_, buffer);
+  }
+
+  // Returns the number of bytes sent (may be less than `buffer.size()`)
+  [[nodiscard]] auto async_send(std::span<const std::byte> buffer)
+  {
+    return detail::socket_awaitable<detail::send_op, std::size_t>(*socket_, buffer);
+  }
+
+private:
+  struct accept_op : detail::reactor_op {
+    int fd;
+    reactor& owner;
+    explicit accept_op(detail::reactor_socket& s) noexcept :
+        reactor_op(direction::read, perform_as<accept_op>), fd(s.fd), owner(s.owner)
+    {
+    }
+    bool try_perform() noexcept
+    {
+      return complete(::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC));
+    }
+    async_socket get() const { return async_socket(owner, static_cast<int>(result)); }
+  };
+
+  detail::reactor_socket* socket_;
+};
+
+}  // namespace mp_coro
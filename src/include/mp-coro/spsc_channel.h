@@ -0,0 +1,283 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/cache_line.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/trace.h>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+
+namespace mp_coro {
+
+// A bounded channel between exactly one producer and one consumer coroutine.
+//
+// The ring buffer indices live on separate cache lines and each side keeps a cached copy of the other
+// side's index, so the shared lines are touched only when the cached view says the buffer is full (empty).
+// A side suspends only on the full (empty) transition and is resumed by its counterpart right after it made
+// room (published a value). `receive_many()` moves all of the available values out in one resume.
+//
+// `send()`/`try_send()`/`close()` may be called only by the producer and `receive()`/`receive_many()`/
+// `try_receive()` only by the consumer.
+template<typename T>
+class spsc_channel : private detail::noncopyable {
+  // The consumer/producer announces its suspension before checking the index of the counterpart again while
+  // the counterpart publishes its index before checking for a suspended coroutine. Both pairs of accesses
+  // are seq_cst so at least one of the sides sees the other one.
+  class waiter_base {
+  public:
+    explicit waiter_base(spsc_channel& channel) noexcept : channel_(channel) {}
+
+  protected:
+    spsc_channel& channel_;
+
+    // `ready` is checked only after the suspension is announced (the awaiter may be already destroyed by then
+    // so it must not be touched)
+    template<std::predicate Ready>
+    static bool suspend(std::atomic<void*>& waiter, std::coroutine_handle<> handle, Ready ready)
+    {
+      waiter.store(handle.address(), std::memory_order_seq_cst);
+      if (!ready()) return true;
+      // the counterpart might have already taken the handle to resume it
+      return waiter.exchange(nullptr, std::memory_order_acq_rel) == nullptr;
+    }
+  };
+
+public:
+  class [[nodiscard]] send_awaitable : private waiter_base {
+  public:
+    send_awaitable(spsc_channel& channel, T value) noexcept(std::is_nothrow_move_constructible_v<T>) :
+        waiter_base(channel), value_(std::move(value))
+    {
+    }
+
+    bool await_ready()
+    {
+      TRACE_FUNC();
+      if (this->channel_.closed()) return true;
+      sent_ = this->channel_.try_send(value_);
+      return sent_;
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      return this->suspend(this->channel_.producer_waiter_, handle,
+                           [&channel = this->channel_] { return !channel.full() || channel.closed(); });
+    }
+
+    // Returns false if the channel was closed before the value was sent
+    bool await_resume()
+    {
+      TRACE_FUNC();
+      return sent_ || (!this->channel_.closed() && this->channel_.try_send(value_));
+    }
+
+  private:
+    T value_;
+    bool sent_ = false;
+  };
+
+  class [[nodiscard]] receive_awaitable : private waiter_base {
+  public:
+    using waiter_base::waiter_base;
+
+    bool await_ready()
+    {
+      TRACE_FUNC();
+      result_ = this->channel_.try_receive();
+      return result_ || this->channel_.closed();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      return this->suspend(this->channel_.consumer_waiter_, handle,
+                           [&channel = this->channel_] { return !channel.empty() || channel.closed(); });
+    }
+
+    // Returns `std::nullopt` if the channel is closed and empty
+    std::optional<T> await_resume()
+    {
+      TRACE_FUNC();
+      if (!result_) result_ = this->channel_.try_receive();
+      return std::move(result_);
+    }
+
+  private:
+    std::optional<T> result_;
+  };
+
+  class [[nodiscard]] receive_many_awaitable : private waiter_base {
+  public:
+    receive_many_awaitable(spsc_channel& channel, std::span<T> out) noexcept : waiter_base(channel), out_(out) {}
+
+    bool await_ready()
+    {
+      TRACE_FUNC();
+      count_ = this->channel_.try_receive_many(out_);
+      return count_ > 0 || out_.empty() || this->channel_.closed();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      return this->suspend(this->channel_.consumer_waiter_, handle,
+                           [&channel = this->channel_] { return !channel.empty() || channel.closed(); });
+    }
+
+    // Returns the number of values moved to the output span (0 if the channel is closed and empty)
+    std::size_t await_resume()
+    {
+      TRACE_FUNC();
+      if (count_ == 0) count_ = this->channel_.try_receive_many(out_);
+      return count_;
+    }
+
+  private:
+    std::span<T> out_;
+    std::size_t count_ = 0;
+  };
+
+  // `capacity` is rounded up to a power of two
+  explicit spsc_channel(std::size_t capacity) :
+      mask_(std::bit_ceil(std::max(capacity, std::size_t{1})) - 1), buffer_(alloc_.allocate(mask_ + 1))
+  {
+  }
+
+  ~spsc_channel()
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    for (std::size_t i = head_.load(std::memory_order_relaxed); i != tail; ++i) std::destroy_at(&buffer_[i & mask_]);
+    alloc_.deallocate(buffer_, mask_ + 1);
+  }
+
+  [[nodiscard]] std::size_t capacity() const noexcept { return mask_ + 1; }
+  [[nodiscard]] bool closed() const noexcept { return closed_.load(std::memory_order_seq_cst); }
+
+  [[nodiscard]] send_awaitable send(T value) { return send_awaitable(*this, std::move(value)); }
+  [[nodiscard]] receive_awaitable receive() noexcept { return receive_awaitable(*this); }
+
+  // Suspends until at least one value is available and moves as many of the available values as fit in `out`
+  [[nodiscard]] receive_many_awaitable receive_many(std::span<T> out) noexcept
+  {
+    return receive_many_awaitable(*this, out);
+  }
+
+  // Moves from `value` only on success; returns false if the channel is full
+  bool try_send(T& value)
+  {
+    const std::size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_cache_ > mask_) {
+      head_cache_ = head_.load(std::memory_order_acquire);
+      if (tail - head_cache_ > mask_) return false;
+    }
+    std::construct_at(&buffer_[tail & mask_], std::move(value));
+    tail_.store(tail + 1, std::memory_order_seq_cst);
+    resume(consumer_waiter_);
+    return true;
+  }
+
+  [[nodiscard]] std::optional<T> try_receive()
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_cache_) {
+      tail_cache_ = tail_.load(std::memory_order_acquire);
+      if (head == tail_cache_) return std::nullopt;
+    }
+    T& slot = buffer_[head & mask_];
+    std::optional<T> result(std::move(slot));
+    std::destroy_at(&slot);
+    head_.store(head + 1, std::memory_order_seq_cst);
+    resume(producer_waiter_);
+    return result;
+  }
+
+  // Moves as many of the available values as fit in `out` and returns their number
+  std::size_t try_receive_many(std::span<T> out)
+  {
+    const std::size_t head = head_.load(std::memory_order_relaxed);
+    if (tail_cache_ - head < out.size()) tail_cache_ = tail_.load(std::memory_order_acquire);
+    const std::size_t count = std::min(tail_cache_ - head, out.size());
+    if (count == 0) return 0;
+    // at most two contiguous ranges of the ring buffer
+    const std::size_t first = std::min(count, capacity() - (head & mask_));
+    T* const begin = &buffer_[head & mask_];
+    std::move(begin, begin + first, out.begin());
+    std::destroy(begin, begin + first);
+    std::move(buffer_, buffer_ + (count - first), out.begin() + static_cast<std::ptrdiff_t>(first));
+    std::destroy(buffer_, buffer_ + (count - first));
+    head_.store(head + count, std::memory_order_seq_cst);
+    resume(producer_waiter_);
+    return count;
+  }
+
+  // Resumes the consumer suspended on the empty channel (has to be called by the producer)
+  void close()
+  {
+    TRACE_FUNC();
+    closed_.store(true, std::memory_order_seq_cst);
+    resume(consumer_waiter_);
+  }
+
+private:
+  [[no_unique_address]] std::allocator<T> alloc_;
+  const std::size_t mask_;
+  T* const buffer_;
+  std::atomic<bool> closed_ = false;
+  alignas(detail::cache_line_size) std::atomic<std::size_t> tail_ = 0;  // written by the producer
+  alignas(detail::cache_line_size) std::size_t head_cache_ = 0;         // producer's view of `head_`
+  alignas(detail::cache_line_size) std::atomic<std::size_t> head_ = 0;  // written by the consumer
+  alignas(detail::cache_line_size) std::size_t tail_cache_ = 0;         // consumer's view of `tail_`
+  // written only on suspension so the lines stay shared in the caches of both sides
+  alignas(detail::cache_line_size) std::atomic<void*> producer_waiter_ = nullptr;
+  alignas(detail::cache_line_size) std::atomic<void*> consumer_waiter_ = nullptr;
+
+  [[nodiscard]] bool full() const noexcept
+  {
+    return tail_.load(std::memory_order_relaxed) - head_.load(std::memory_order_seq_cst) > mask_;
+  }
+
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return head_.load(std::memory_order_relaxed) == tail_.load(std::memory_order_seq_cst);
+  }
+
+  static void resume(std::atomic<void*>& waiter)
+  {
+    if (waiter.load(std::memory_order_seq_cst) == nullptr) return;
+    if (void* address = waiter.exchange(nullptr, std::memory_order_acq_rel))
+      std::coroutine_handle<>::from_address(address).resume();
+  }
+};
+
+}  // namespace mp_coro
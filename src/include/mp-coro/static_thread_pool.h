@@ -0,0 +1,191 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/chase_lev_deque.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/trace.h>
+#include <algorithm>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <vector>
+
+namespace mp_coro {
+
+// A fixed-size pool of worker threads with per-worker work-stealing deques.
+//
+// Coroutines scheduled from one of the pool's own threads are pushed to the local deque of that worker
+// (no locking) while the ones scheduled from the outside of the pool go through a shared injection queue.
+// Idle workers steal from other workers before going to sleep.
+class static_thread_pool : private detail::noncopyable {
+public:
+  explicit static_thread_pool(std::size_t thread_count = std::max(std::thread::hardware_concurrency(), 1U)) :
+      workers_(std::make_unique<worker[]>(thread_count)), worker_count_(thread_count)
+  {
+    TRACE_FUNC();
+    threads_.reserve(thread_count);
+    for (std::size_t i = 0; i < thread_count; ++i) {
+      workers_[i].pool = this;
+      workers_[i].index = i;
+      threads_.emplace_back([this, i](std::stop_token stop) { run(workers_[i], stop); });
+    }
+  }
+
+  ~static_thread_pool()
+  {
+    TRACE_FUNC();
+    for (auto& t : threads_) t.request_stop();
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    epoch_.notify_all();
+    threads_.clear();
+  }
+
+  [[nodiscard]] std::size_t thread_count() const noexcept { return worker_count_; }
+
+  // Returns an awaiter that resumes the awaiting coroutine on one of the pool's threads
+  [[nodiscard]] awaiter_of<void> auto schedule() noexcept
+  {
+    struct schedule_awaiter {
+      static_thread_pool& pool;
+      static bool await_ready() noexcept
+      {
+        TRACE_FUNC();
+        return false;
+      }
+      void await_suspend(std::coroutine_handle<> handle)
+      {
+        TRACE_FUNC();
+        pool.enqueue(handle);
+      }
+      static void await_resume() noexcept { TRACE_FUNC(); }
+    };
+    TRACE_FUNC();
+    return schedule_awaiter{*this};
+  }
+
+  // Enqueues a suspended coroutine to be resumed on one of the pool's threads
+  void enqueue(std::coroutine_handle<> handle)
+  {
+    TRACE_FUNC();
+    if (current_worker_ && current_worker_->pool == this)
+      current_worker_->deque.push(handle);
+    else {
+      std::lock_guard lock(mutex_);
+      injection_queue_.push_back(handle);
+      injection_size_.fetch_add(1, std::memory_order_relaxed);
+    }
+    wake_one();
+  }
+
+private:
+  struct worker {
+    static_thread_pool* pool = nullptr;
+    std::size_t index = 0;
+    detail::chase_lev_deque deque;
+  };
+
+  inline static thread_local worker* current_worker_ = nullptr;
+
+  std::unique_ptr<worker[]> workers_;
+  std::size_t worker_count_;
+  std::mutex mutex_;
+  std::deque<std::coroutine_handle<>> injection_queue_;
+  std::atomic<std::size_t> injection_size_ = 0;
+  std::atomic<std::uint32_t> epoch_ = 0;  // bumped on every new work item to wake up sleeping workers
+  std::atomic<std::size_t> sleeping_ = 0;
+  std::vector<std::jthread> threads_;
+
+  void wake_one()
+  {
+    // The `seq_cst` ordering pairs with the one in `run()` so that either a worker going to sleep observes
+    // a new epoch or the producer observes a sleeping worker and wakes it up.
+    epoch_.fetch_add(1, std::memory_order_seq_cst);
+    if (sleeping_.load(std::memory_order_seq_cst) > 0) epoch_.notify_one();
+  }
+
+  std::coroutine_handle<> try_dequeue_injected()
+  {
+    if (injection_size_.load(std::memory_order_relaxed) == 0) return nullptr;
+    std::lock_guard lock(mutex_);
+    if (injection_queue_.empty()) return nullptr;
+    auto handle = injection_queue_.front();
+    injection_queue_.pop_front();
+    injection_size_.fetch_sub(1, std::memory_order_relaxed);
+    return handle;
+  }
+
+  std::coroutine_handle<> try_steal(const worker& self) noexcept
+  {
+    for (std::size_t i = 1; i < worker_count_; ++i)
+      if (auto handle = workers_[(self.index + i) % worker_count_].deque.steal()) return handle;
+    return nullptr;
+  }
+
+  std::coroutine_handle<> next_work(worker& self)
+  {
+    if (auto handle = self.deque.pop()) return handle;
+    if (auto handle = try_dequeue_injected()) return handle;
+    return try_steal(self);
+  }
+
+  void run(worker& self, std::stop_token stop)
+  {
+    TRACE_FUNC();
+    current_worker_ = &self;
+    while (true) {
+      if (auto handle = next_work(self)) {
+        handle.resume();
+        continue;
+      }
+      if (stop.stop_requested()) break;
+
+      sleeping_.fetch_add(1, std::memory_order_seq_cst);
+      const auto epoch = epoch_.load(std::memory_order_seq_cst);
+      if (auto handle = next_work(self)) {
+        sleeping_.fetch_sub(1, std::memory_order_relaxed);
+        handle.resume();
+        continue;
+      }
+      if (!stop.stop_requested()) epoch_.wait(epoch, std::memory_order_seq_cst);
+      sleeping_.fetch_sub(1, std::memory_order_relaxed);
+    }
+    current_worker_ = nullptr;
+  }
+};
+
+// A lazily created pool used by `async` when no other pool is provided
+[[nodiscard]] inline static_thread_pool& default_thread_pool()
+{
+  static static_thread_pool pool;
+  return pool;
+}
+
+}  // namespace mp_coro
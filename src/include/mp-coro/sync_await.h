@@ -22,27 +22,37 @@
 
 #pragma once
 
+#include <mp-coro/bits/one_shot_event.h>
 #include <mp-coro/bits/synchronized_task.h>
 #include <mp-coro/concepts.h>
 #include <mp-coro/trace.h>
-#include <latch>
+#include <mp-coro/type_traits.h>
+#include <stop_token>
 
 namespace mp_coro {
 
+// The awaitable inherits `token` and may use it to stop the work before its completion
 template<awaitable A>
-[[nodiscard]] decltype(auto) sync_await(A&& awaitable)
+[[nodiscard]] remove_rvalue_reference_t<await_result_t<A>> sync_await(std::stop_token token, A&& awaitable)
 {
   struct sync {
-    std::latch latch{1};
-    void notify_awaitable_completed() { latch.count_down(); }
+    detail::one_shot_event event;
+    void notify_awaitable_completed() { event.set(); }
   };
 
   TRACE_FUNC();
   auto sync_task = detail::make_synchronized_task<sync>(std::forward<A>(awaitable));
   sync work_done;
-  sync_task.start(work_done);
-  work_done.latch.wait();
-  return sync_task.get();
+  sync_task.start(work_done, std::move(token));
+  work_done.event.wait();
+  return std::move(sync_task).get();
+}
+
+template<awaitable A>
+[[nodiscard]] remove_rvalue_reference_t<await_result_t<A>> sync_await(A&& awaitable)
+{
+  TRACE_FUNC();
+  return sync_await(std::stop_token(), std::forward<A>(awaitable));
 }
 
 }  // namespace mp_coro
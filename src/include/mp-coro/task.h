@@ -23,7 +23,10 @@
 #pragma once
 
 #include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/promise_allocator.h>
+#include <mp-coro/bits/stop_scope.h>
 #include <mp-coro/bits/task_promise_storage.h>
+#include <mp-coro/cancellation.h>
 #include <mp-coro/concepts.h>
 #include <mp-coro/coro_ptr.h>
 #include <mp-coro/trace.h>
@@ -33,14 +36,29 @@
 
 namespace mp_coro {
 
+namespace detail {
+
+template<typename Sync, typename A>
+class task_operation;
+
+}  // namespace detail
+
 template<task_value_type T = void, typename Allocator = void>
 class [[nodiscard]] task {
 public:
   using value_type = T;
 
-  struct promise_type : private detail::noncopyable, detail::task_promise_storage<T> {
+  struct promise_type :
+      private detail::noncopyable,
+      detail::task_promise_storage<T>,
+      detail::promise_allocator<Allocator>,
+      detail::promise_stop_token {
     std::coroutine_handle<> continuation = std::noop_coroutine();
 
+    // Used instead of `continuation` when the task is started directly by a synchronization primitive
+    void* sync = nullptr;
+    void (*notify_completed)(promise_type& promise) noexcept = nullptr;
+
     static std::suspend_always initial_suspend() noexcept
     {
       TRACE_FUNC();
@@ -53,7 +71,12 @@ public:
         std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> this_coro) noexcept
         {
           TRACE_FUNC();
-          return this_coro.promise().continuation;
+          promise_type& promise = this_coro.promise();
+          if (promise.notify_completed) {
+            promise.notify_completed(promise);
+            return std::noop_coroutine();
+          }
+          return promise.continuation;
         }
       };
       TRACE_FUNC();
@@ -99,6 +122,15 @@ public:
   }
 
 private:
+  template<typename Sync, typename A>
+  friend class detail::task_operation;
+
+  // the not yet started task inherits the stop token of the awaiting coroutine
+  friend void inherit_stop_token(const task& t, const detail::lazy_stop_token& token) noexcept
+  {
+    t.promise_->stop_token = token;
+  }
+
   struct awaiter {
     promise_type& promise;
 
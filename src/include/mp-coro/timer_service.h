@@ -0,0 +1,245 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/timer_wheel.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/static_thread_pool.h>
+#include <mp-coro/trace.h>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <thread>
+#include <utility>
+
+namespace mp_coro {
+
+// Parks the coroutines awaiting for timers in a hierarchical timer wheel driven by a dedicated thread.
+//
+// No thread is blocked by a sleeping coroutine. Expired coroutines are resumed on the timer thread or,
+// if a pool is provided, on the pool's threads. All timers have to complete before the service is destroyed.
+class timer_service : private detail::noncopyable {
+public:
+  using clock = std::chrono::steady_clock;
+  using tick = std::chrono::milliseconds;
+
+  class [[nodiscard]] sleep_awaitable {
+  public:
+    sleep_awaitable(timer_service& service, clock::time_point deadline) noexcept :
+        service_(service), deadline_(deadline)
+    {
+    }
+
+    // only a not awaited sleep can be moved
+    sleep_awaitable(sleep_awaitable&& other) noexcept :
+        service_(other.service_), deadline_(other.deadline_), stop_token_(std::move(other.stop_token_))
+    {
+    }
+    sleep_awaitable& operator=(sleep_awaitable&&) = delete;
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return deadline_ <= clock::now() || stop_token_.stop_requested();
+    }
+
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      node_.handle = handle;
+      // a stop requested in the meantime ends the sleep early
+      if (stop_token_.stop_possible()) stop_callback_.emplace(stop_token_, cancel{this});
+      return service_.schedule(node_, deadline_);
+    }
+
+    static void await_resume() noexcept { TRACE_FUNC(); }
+
+  private:
+    struct cancel {
+      sleep_awaitable* self;
+      void operator()() const noexcept { self->service_.cancel(self->node_); }
+    };
+
+    timer_service& service_;
+    clock::time_point deadline_;
+    std::stop_token stop_token_;
+    detail::timer_node node_;
+    std::optional<std::stop_callback<cancel>> stop_callback_;
+
+    friend void inherit_stop_token(sleep_awaitable& awaitable, const std::stop_token& token) noexcept
+    {
+      awaitable.stop_token_ = token;
+    }
+  };
+
+  timer_service() : timer_service(nullptr) {}
+  explicit timer_service(static_thread_pool& pool) : timer_service(&pool) {}
+
+  ~timer_service()
+  {
+    TRACE_FUNC();
+    thread_.request_stop();
+    thread_.join();
+  }
+
+  [[nodiscard]] sleep_awaitable sleep_until(clock::time_point deadline) noexcept { return {*this, deadline}; }
+
+  template<typename Rep, typename Period>
+  [[nodiscard]] sleep_awaitable sleep_for(std::chrono::duration<Rep, Period> duration)
+  {
+    return {*this, clock::now() + std::chrono::ceil<clock::duration>(duration)};
+  }
+
+  // The number of the pending timers
+  [[nodiscard]] std::size_t size() const
+  {
+    std::lock_guard lock(mutex_);
+    return wheel_.size();
+  }
+
+private:
+  static_thread_pool* pool_;
+  const clock::time_point start_ = clock::now();
+  mutable std::mutex mutex_;
+  std::condition_variable_any cv_;
+  detail::timer_wheel wheel_;
+  std::uint64_t wake_tick_ = detail::timer_wheel::never;  // the tick the timer thread sleeps until
+  bool woken_ = false;
+  std::jthread thread_;
+
+  explicit timer_service(static_thread_pool* pool) : pool_(pool)
+  {
+    TRACE_FUNC();
+    thread_ = std::jthread([this](std::stop_token stop) { run(stop); });
+  }
+
+  std::uint64_t current_tick() const { return static_cast<std::uint64_t>((clock::now() - start_) / tick(1)); }
+
+  std::uint64_t deadline_tick(clock::time_point deadline) const
+  {
+    // rounded up so a timer never expires too early
+    return static_cast<std::uint64_t>(std::chrono::ceil<tick>(deadline - start_).count());
+  }
+
+  void resume(std::coroutine_handle<> handle)
+  {
+    if (pool_)
+      pool_->enqueue(handle);
+    else
+      handle.resume();
+  }
+
+  // Returns false if the coroutine should not be suspended (the timer has already expired or was cancelled)
+  bool schedule(detail::timer_node& node, clock::time_point deadline)
+  {
+    std::lock_guard lock(mutex_);
+    if (node.st == detail::timer_node::state::cancelled) return false;
+    node.expiry = deadline_tick(deadline);
+    if (node.expiry <= wheel_.now()) return false;
+    wheel_.insert(node);
+    node.st = detail::timer_node::state::linked;
+    if (node.expiry < wake_tick_) {
+      woken_ = true;
+      cv_.notify_one();
+    }
+    return true;
+  }
+
+  void cancel(detail::timer_node& node)
+  {
+    {
+      std::lock_guard lock(mutex_);
+      if (node.st == detail::timer_node::state::pending) {
+        // the timer is not scheduled yet
+        node.st = detail::timer_node::state::cancelled;
+        return;
+      }
+      if (node.st != detail::timer_node::state::linked) return;
+      wheel_.remove(node);
+      node.st = detail::timer_node::state::done;
+    }
+    resume(node.handle);
+  }
+
+  void run(std::stop_token stop)
+  {
+    TRACE_FUNC();
+    std::unique_lock lock(mutex_);
+    while (!stop.stop_requested()) {
+      // expired timers are chained with their `next` pointers
+      detail::timer_node* first = nullptr;
+      detail::timer_node** last = &first;
+      wheel_.advance(current_tick(), [&](detail::timer_node& node) {
+        node.st = detail::timer_node::state::done;
+        node.next = nullptr;
+        *last = &node;
+        last = &node.next;
+      });
+      if (first) {
+        lock.unlock();
+        while (first) {
+          // the node may be destroyed as soon as its coroutine is resumed
+          auto handle = first->handle;
+          first = first->next;
+          resume(handle);
+        }
+        lock.lock();
+        continue;
+      }
+
+      wake_tick_ = wheel_.next_event();
+      woken_ = false;
+      if (wake_tick_ == detail::timer_wheel::never)
+        cv_.wait(lock, stop, [&] { return woken_; });
+      else
+        cv_.wait_until(lock, stop, start_ + tick(wake_tick_), [&] { return woken_; });
+    }
+  }
+};
+
+// A lazily created timer service resuming the coroutines on `default_thread_pool()`
+[[nodiscard]] inline timer_service& default_timer_service()
+{
+  static timer_service service(default_thread_pool());
+  return service;
+}
+
+// Suspends the awaiting coroutine (without blocking any thread) until `deadline` or the stop is requested
+[[nodiscard]] inline timer_service::sleep_awaitable sleep_until(timer_service::clock::time_point deadline)
+{
+  return default_timer_service().sleep_until(deadline);
+}
+
+template<typename Rep, typename Period>
+[[nodiscard]] timer_service::sleep_awaitable sleep_for(std::chrono::duration<Rep, Period> duration)
+{
+  return default_timer_service().sleep_for(duration);
+}
+
+}  // namespace mp_coro
@@ -22,15 +22,29 @@
 
 #pragma once
 
-#include <mp-coro/bits/synchronized_task.h>
+#include <mp-coro/bits/cache_line.h>
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/operation.h>
+#include <mp-coro/bits/stop_scope.h>
 #include <mp-coro/concepts.h>
 #include <mp-coro/trace.h>
 #include <mp-coro/type_traits.h>
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <concepts>
 #include <coroutine>
+#include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
 #include <ranges>
+#include <span>
+#include <stdexcept>
+#include <stop_token>
+#include <thread>
 #include <tuple>
+#include <type_traits>
 #include <vector>
 
 namespace mp_coro {
@@ -40,11 +54,24 @@ namespace detail {
 class when_all_sync {
   std::atomic<std::size_t> counter_;
   std::coroutine_handle<> continuation_;
+  stop_scope stop_;
 public:
-  constexpr when_all_sync(std::size_t count) noexcept : counter_(count + 1)  // +1 for attaching a continuation
+  when_all_sync(std::size_t count) : counter_(count + 1)  // +1 for attaching a continuation
   {
   }
-  when_all_sync(when_all_sync&& other) noexcept : counter_(other.counter_.load()), continuation_(other.continuation_) {}
+  when_all_sync(when_all_sync&& other) noexcept :
+      counter_(other.counter_.load()), continuation_(other.continuation_), stop_(std::move(other.stop_))
+  {
+  }
+
+  // The awaitables are stopped when the awaiting coroutine is stopped or on the first failure
+  void set_parent_stop_token(std::stop_token token) noexcept { stop_.set_parent(std::move(token)); }
+  lazy_stop_token start_stop_scope()
+  {
+    stop_.start();
+    return lazy_stop_token(stop_);
+  }
+  void notify_awaitable_failed() noexcept { stop_.request_stop(); }
 
   // Returns false when a continuation is being attached when all work is already done
   // and the current coroutine should be resumed right away via Symmetric Control Transfer.
@@ -66,6 +93,53 @@ public:
   bool is_ready() const { return static_cast<bool>(continuation_); }
 };
 
+// A leaf of a combining tree of counters. Notifies the root counter when all of its awaitables complete.
+struct alignas(cache_line_size) when_all_shard {
+  std::atomic<std::size_t> counter = 0;
+  when_all_sync* root = nullptr;
+
+  void notify_awaitable_failed() noexcept { root->notify_awaitable_failed(); }
+  void notify_awaitable_completed()
+  {
+    if (counter.fetch_sub(1, std::memory_order_acq_rel) == 1) root->notify_awaitable_completed();
+  }
+};
+
+// Spreads the completions of a large number of concurrently running awaitables over separate cache lines.
+// Each of the shards counts a contiguous chunk of awaitables and only the last completion in a chunk
+// touches the root counter.
+class when_all_sharded_sync {
+  std::size_t shard_size_;
+  std::vector<when_all_shard> shards_;
+  when_all_sync root_;
+
+  static std::size_t max_shards() { return 4 * std::max(std::thread::hardware_concurrency(), 1u); }
+public:
+  explicit when_all_sharded_sync(std::size_t count) :
+      shard_size_(std::max<std::size_t>((count + max_shards() - 1) / max_shards(), 1)),
+      shards_((count + shard_size_ - 1) / shard_size_),
+      root_(shards_.size())
+  {
+    for (std::size_t i = 0; i < shards_.size(); ++i)
+      shards_[i].counter.store(std::min(shard_size_, count - i * shard_size_), std::memory_order_relaxed);
+  }
+
+  // Shards are allocated on the heap so the root is assigned after the awaitable reaches its final location
+  void attach_root()
+  {
+    for (auto& shard : shards_) shard.root = &root_;
+  }
+
+  void set_parent_stop_token(std::stop_token token) noexcept { root_.set_parent_stop_token(std::move(token)); }
+  lazy_stop_token start_stop_scope() { return root_.start_stop_scope(); }
+
+  when_all_shard& shard(std::size_t index) { return shards_[index / shard_size_]; }
+  bool set_continuation(std::coroutine_handle<> cont) { return root_.set_continuation(cont); }
+  bool is_ready() const { return root_.is_ready(); }
+};
+
+template<typename Policy>
+struct when_all_counter;
 
 template<typename T>
 std::size_t tasks_size(T& container)
@@ -79,21 +153,38 @@ std::size_t tasks_size(T& container)
 template<typename T>
 decltype(auto) start_all_tasks(T& container, when_all_sync& sync)
 {
+  const lazy_stop_token token = sync.start_stop_scope();
   if constexpr (std::ranges::range<T>)
-    for (auto& t : container) t.start(sync);
+    for (auto& t : container) t.start(sync, token);
   else
-    std::apply([&](auto&... tasks) { (..., tasks.start(sync)); }, container);
+    std::apply([&](auto&... tasks) { (..., tasks.start(sync, token)); }, container);
+}
+
+template<typename T>
+void start_all_tasks(T& container, when_all_sharded_sync& sync)
+{
+  sync.attach_root();
+  const lazy_stop_token token = sync.start_stop_scope();
+  std::size_t index = 0;
+  for (auto& t : container) t.start(sync.shard(index++), token);
 }
 
 template<typename T>
 decltype(auto) make_all_results(T&& container)
 {
   if constexpr (std::ranges::range<T>) {
-    if constexpr (std::is_void_v<typename std::ranges::range_value_t<T>::value_type>) {
+    using value_type = typename std::ranges::range_value_t<T>::value_type;
+    if constexpr (std::is_void_v<value_type>) {
       // in case of `void` check for exception and do not return any result
       for (auto& task : container) task.get();
     } else {
-      std::vector<typename std::ranges::range_value_t<T>::value_type> result;
+      // references can't be stored in a vector
+      using result_type = std::conditional_t<std::is_reference_v<value_type>,
+                                             std::reference_wrapper<std::remove_reference_t<value_type>>, value_type>;
+      // results are allocated in the same way as the operations
+      using allocator_type = typename std::allocator_traits<
+        typename std::remove_cvref_t<T>::allocator_type>::template rebind_alloc<result_type>;
+      std::vector<result_type, allocator_type> result{allocator_type(container.get_allocator())};
       result.reserve(size(container));
       for (auto&& task : std::forward<T>(container)) result.emplace_back(std::forward<decltype(task)>(task).get());
       return result;
@@ -113,9 +204,32 @@ decltype(auto) make_all_results(T&& container)
   }
 }
 
+// Throws if `out` is too small for the results of all of the operations (before any of them is started)
+template<typename T, typename U>
+T&& check_results_size(T&& operations, std::span<U> out)
+{
+  if (size(operations) > out.size()) throw std::length_error("when_all: the output span is too small for the results");
+  return std::forward<T>(operations);
+}
+
+// Writes the results to the storage provided by the user instead of returning them
+template<typename T, typename U>
+void make_all_results(T&& container, std::span<U> out)
+{
+  assert(size(container) <= out.size() && "The output span is too small for all of the results");
+  auto it = out.begin();
+  for (auto&& task : std::forward<T>(container)) *it++ = std::forward<decltype(task)>(task).get();
+}
+
 template<typename T>
+decltype(auto) make_all_results(T&& container, void_type)
+{
+  return make_all_results(std::forward<T>(container));
+}
+
+template<typename T, typename Out = void_type, typename Sync = when_all_sync>
 struct when_all_awaitable {
-  explicit when_all_awaitable(T&& tasks) : tasks_(std::move(tasks)) {}
+  explicit when_all_awaitable(T&& tasks, Out out = {}) : tasks_(std::move(tasks)), out_(out) {}
 
   decltype(auto) operator co_await() &
   {
@@ -123,7 +237,7 @@ struct when_all_awaitable {
       decltype(auto) await_resume()
       {
         TRACE_FUNC();
-        return make_all_results(this->awaitable.tasks_);
+        return make_all_results(this->awaitable.tasks_, this->awaitable.out_);
       }
     };
     return awaiter{{*this}};
@@ -135,13 +249,18 @@ struct when_all_awaitable {
       decltype(auto) await_resume()
       {
         TRACE_FUNC();
-        return make_all_results(std::move(this->awaitable.tasks_));
+        return make_all_results(std::move(this->awaitable.tasks_), this->awaitable.out_);
       }
     };
     return awaiter{{*this}};
   }
 
 private:
+  friend void inherit_stop_token(when_all_awaitable& awaitable, const std::stop_token& token) noexcept
+  {
+    awaitable.sync_.set_parent_stop_token(token);
+  }
+
   struct awaiter_base {
     when_all_awaitable& awaitable;
 
@@ -158,31 +277,224 @@ private:
     }
   };
   T tasks_;
-  when_all_sync sync_ = tasks_size(tasks_);
+  [[no_unique_address]] Out out_;
+  Sync sync_{tasks_size(tasks_)};
+};
+
+// Keeps at most `max_in_flight` tasks running. Each completing task hands over the start of the next one
+// to a single thread driving the loop, so synchronously completing tasks do not grow the stack.
+class when_all_n_sync : private noncopyable {
+  std::size_t count_;
+  std::size_t max_in_flight_;
+  std::size_t next_ = 0;                  // index of the next task to start (used only by the driving thread)
+  std::atomic<std::size_t> pending_ = 0;  // 0 when no thread drives the loop, otherwise 1 + completions to handle
+  when_all_sync done_;
+  lazy_stop_token stop_token_;
+
+  void start_next()
+  {
+    if (next_ < count_) start_task(next_++);
+  }
+
+  // starts tasks for completions reported while the current thread drives the loop
+  void drive()
+  {
+    while (pending_.fetch_sub(1, std::memory_order_acq_rel) != 1) start_next();
+  }
+protected:
+  virtual void start_task(std::size_t index) = 0;
+  const lazy_stop_token& stop_token() const noexcept { return stop_token_; }
+public:
+  when_all_n_sync(std::size_t count, std::size_t max_in_flight) :
+      count_(count), max_in_flight_(max_in_flight), done_(count)
+  {
+  }
+  when_all_n_sync(when_all_n_sync&& other) noexcept :
+      count_(other.count_), max_in_flight_(other.max_in_flight_), done_(std::move(other.done_))
+  {
+  }
+  virtual ~when_all_n_sync() = default;
+
+  // Returns false when all the work is already done and the current coroutine should be resumed right away
+  bool start(std::coroutine_handle<> cont)
+  {
+    stop_token_ = done_.start_stop_scope();
+    pending_.store(1, std::memory_order_relaxed);
+    for (const std::size_t initial = std::min(count_, max_in_flight_); next_ < initial;) start_task(next_++);
+    drive();
+    return done_.set_continuation(cont);
+  }
+
+  void notify_awaitable_completed()
+  {
+    // only the first of the concurrently completing tasks becomes the driving thread
+    if (pending_.fetch_add(1, std::memory_order_acq_rel) == 0) {
+      start_next();
+      drive();
+    }
+    // `this` may be destroyed here if the last task completes
+    done_.notify_awaitable_completed();
+  }
+
+  void set_parent_stop_token(std::stop_token token) noexcept { done_.set_parent_stop_token(std::move(token)); }
+  void notify_awaitable_failed() noexcept { done_.notify_awaitable_failed(); }
+  bool is_ready() const { return done_.is_ready(); }
+};
+
+template<typename T>
+class when_all_n_awaitable : private when_all_n_sync {
+  T tasks_;
+  void start_task(std::size_t index) override { tasks_[index].start(*this, stop_token()); }
+public:
+  when_all_n_awaitable(T&& tasks, std::size_t max_in_flight) :
+      when_all_n_sync(size(tasks), max_in_flight), tasks_(std::move(tasks))
+  {
+  }
+  when_all_n_awaitable(when_all_n_awaitable&&) = default;
+
+  decltype(auto) operator co_await() &
+  {
+    struct awaiter : awaiter_base {
+      decltype(auto) await_resume()
+      {
+        TRACE_FUNC();
+        return make_all_results(this->awaitable.tasks_);
+      }
+    };
+    return awaiter{{*this}};
+  }
+
+  decltype(auto) operator co_await() &&
+  {
+    struct awaiter : awaiter_base {
+      decltype(auto) await_resume()
+      {
+        TRACE_FUNC();
+        return make_all_results(std::move(this->awaitable.tasks_));
+      }
+    };
+    return awaiter{{*this}};
+  }
+
+private:
+  friend void inherit_stop_token(when_all_n_awaitable& awaitable, const std::stop_token& token) noexcept
+  {
+    awaitable.set_parent_stop_token(token);
+  }
+
+  struct awaiter_base {
+    when_all_n_awaitable& awaitable;
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return awaitable.is_ready();
+    }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      return awaitable.start(handle);
+    }
+  };
+};
+
+}  // namespace detail
+
+// Policies of counting the completions of the awaitables in a range `when_all`
+struct single_counter {};   // one atomic counter shared by all of the awaitables (the default)
+struct sharded_counter {};  // cache line aligned counters of chunks of awaitables combined by a root counter
+
+namespace detail {
+
+template<>
+struct when_all_counter<single_counter> {
+  using type = when_all_sync;
 };
 
+template<>
+struct when_all_counter<sharded_counter> {
+  using type = when_all_sharded_sync;
+};
+
+// The operations of the awaitables are notifying either the main or a shard counter
+template<typename Policy>
+using when_all_operation_sync =
+  std::conditional_t<std::is_same_v<Policy, sharded_counter>, when_all_shard, when_all_sync>;
+
+template<typename Policy, typename Operations, typename Out = void_type>
+auto make_when_all_awaitable(Operations&& operations, Out out = {})
+{
+  return when_all_awaitable<Operations, Out, typename when_all_counter<Policy>::type>(std::move(operations), out);
+}
+
 }  // namespace detail
 
 template<awaitable... Awaitables>
 awaitable auto when_all(Awaitables&&... awaitables)
 {
   TRACE_FUNC();
-  return detail::when_all_awaitable(
-    std::make_tuple(detail::make_synchronized_task<detail::when_all_sync>(std::forward<Awaitables>(awaitables))...));
+  return detail::when_all_awaitable(std::make_tuple(
+    detail::make_operation<detail::when_all_sync, Awaitables>(std::forward<Awaitables>(awaitables))...));
 }
 
-template<std::ranges::range R>
+// `Policy` selects how the completions are counted (`sharded_counter` scales better when thousands of
+// awaitables complete concurrently on many threads)
+template<typename Policy = single_counter, std::ranges::range R>
   requires awaitable<std::ranges::range_value_t<R>>
 awaitable auto when_all(R&& awaitables)
 {
   TRACE_FUNC();
-  std::vector<detail::synchronized_task<detail::when_all_sync, await_result_t<std::ranges::range_reference_t<R>>>>
-    tasks;
-  tasks.reserve(size(awaitables));
-  for (auto&& awaitable : std::forward<R>(awaitables))
-    tasks.emplace_back(
-      detail::make_synchronized_task<detail::when_all_sync>(std::forward<decltype(awaitable)>(awaitable)));
-  return detail::when_all_awaitable(std::move(tasks));
+  return detail::make_when_all_awaitable<Policy>(
+    detail::make_operations<detail::when_all_operation_sync<Policy>>(std::forward<R>(awaitables)));
+}
+
+// The operations state and the returned results are allocated with `alloc`
+template<typename Policy = single_counter, typename Alloc, std::ranges::range R>
+  requires awaitable<std::ranges::range_value_t<R>>
+awaitable auto when_all(std::allocator_arg_t, const Alloc& alloc, R&& awaitables)
+{
+  TRACE_FUNC();
+  return detail::make_when_all_awaitable<Policy>(
+    detail::make_operations<detail::when_all_operation_sync<Policy>>(std::forward<R>(awaitables), alloc));
+}
+
+// Writes the results to `results` rather than returning them in a new container.
+// Throws `std::length_error` if `results` is smaller than the range (before any of the awaitables is started).
+template<typename Policy = single_counter, std::ranges::range R, typename U, std::size_t Extent>
+  requires awaitable<std::ranges::range_value_t<R>> &&
+           std::assignable_from<U&, await_result_t<std::ranges::range_reference_t<R>>>
+awaitable auto when_all(R&& awaitables, std::span<U, Extent> results)
+{
+  TRACE_FUNC();
+  const std::span<U> out(results);
+  return detail::make_when_all_awaitable<Policy>(
+    detail::check_results_size(
+      detail::make_operations<detail::when_all_operation_sync<Policy>>(std::forward<R>(awaitables)), out),
+    out);
+}
+
+template<typename Policy = single_counter, typename Alloc, std::ranges::range R, typename U, std::size_t Extent>
+  requires awaitable<std::ranges::range_value_t<R>> &&
+           std::assignable_from<U&, await_result_t<std::ranges::range_reference_t<R>>>
+awaitable auto when_all(std::allocator_arg_t, const Alloc& alloc, R&& awaitables, std::span<U, Extent> results)
+{
+  TRACE_FUNC();
+  const std::span<U> out(results);
+  return detail::make_when_all_awaitable<Policy>(
+    detail::check_results_size(
+      detail::make_operations<detail::when_all_operation_sync<Policy>>(std::forward<R>(awaitables), alloc), out),
+    out);
+}
+
+// Awaits all of the awaitables from the range but keeps at most `max_in_flight` of them running at once
+template<std::ranges::range R>
+  requires awaitable<std::ranges::range_value_t<R>>
+awaitable auto when_all_n(R&& awaitables, std::size_t max_in_flight)
+{
+  TRACE_FUNC();
+  assert(max_in_flight > 0 && "At least one awaitable has to be in flight");
+  return detail::when_all_n_awaitable(
+    detail::make_operations<detail::when_all_n_sync>(std::forward<R>(awaitables)), max_in_flight);
 }
 
 }  // namespace mp_coro
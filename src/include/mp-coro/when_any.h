@@ -0,0 +1,300 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/noncopyable.h>
+#include <mp-coro/bits/operation.h>
+#include <mp-coro/bits/stop_scope.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/trace.h>
+#include <mp-coro/type_traits.h>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <ranges>
+#include <stop_token>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace mp_coro {
+
+// The result of `when_any` for a range of awaitables
+template<typename T>
+struct when_any_result {
+  std::size_t index;
+  T value;
+};
+
+template<>
+struct when_any_result<void> {
+  std::size_t index;
+};
+
+namespace detail {
+
+// The shared state of a `when_any` operation.
+//
+// It is reference-counted as the awaitables that lost the race may still be running after the awaiting
+// coroutine is resumed. Their frames are destroyed together with the state when the last of them completes.
+class when_any_sync : private noncopyable {
+  static constexpr std::size_t no_winner = std::numeric_limits<std::size_t>::max();
+  std::atomic<std::size_t> winner_ = no_winner;
+  std::atomic<std::size_t> refs_ = 1;      // +1 for the awaitable
+  std::atomic<std::size_t> handshake_ = 2;  // the first completion and attaching a continuation
+  std::coroutine_handle<> continuation_;
+  stop_scope stop_;  // the losers are stopped as soon as the winner is known
+public:
+  virtual ~when_any_sync() = default;
+
+  void acquire(std::size_t count) noexcept { refs_.fetch_add(count, std::memory_order_relaxed); }
+  void release() noexcept
+  {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;
+  }
+
+  // Returns false when the winner is already known and the current coroutine should be resumed right away
+  bool set_continuation(std::coroutine_handle<> cont)
+  {
+    continuation_ = cont;
+    return handshake_.fetch_sub(1, std::memory_order_acq_rel) > 1;
+  }
+
+  void set_parent_stop_token(std::stop_token token) noexcept { stop_.set_parent(std::move(token)); }
+  lazy_stop_token start_stop_scope()
+  {
+    stop_.start();
+    return lazy_stop_token(stop_);
+  }
+
+  // Only the first completed awaitable claims the win, stops the rest of them, and resumes the continuation.
+  // Please note that the state may be destroyed during this call.
+  void notify_awaitable_completed(std::size_t index)
+  {
+    std::size_t expected = no_winner;
+    if (winner_.compare_exchange_strong(expected, index, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+      stop_.request_stop();
+      if (handshake_.fetch_sub(1, std::memory_order_acq_rel) == 1) continuation_.resume();
+    }
+    release();
+  }
+
+  bool is_ready() const { return static_cast<bool>(continuation_); }
+  std::size_t winner() const { return winner_.load(std::memory_order_acquire); }
+};
+
+// Identifies the completed awaitable
+struct when_any_slot {
+  when_any_sync* sync;
+  std::size_t index;
+  void notify_awaitable_completed() { sync->notify_awaitable_completed(index); }
+};
+
+template<typename T>
+struct when_any_alternative {
+  using type = T;
+};
+
+template<typename T>
+struct when_any_alternative<T&> {
+  using type = std::reference_wrapper<T>;
+};
+
+template<>
+struct when_any_alternative<void> {
+  using type = void_type;
+};
+
+template<typename T>
+struct when_any_variant;
+
+template<typename... Tasks>
+struct when_any_variant<std::tuple<Tasks...>> {
+  using type = std::variant<typename when_any_alternative<typename Tasks::value_type>::type...>;
+};
+
+template<typename T>
+struct when_any_slots {
+  using type = std::vector<when_any_slot>;
+};
+
+template<typename... Tasks>
+struct when_any_slots<std::tuple<Tasks...>> {
+  using type = std::array<when_any_slot, sizeof...(Tasks)>;
+};
+
+template<typename T>
+class when_any_state : public when_any_sync {
+  T tasks_;
+  typename when_any_slots<T>::type slots_;
+
+  template<std::size_t I, typename Tasks>
+  static auto make_variant(Tasks&& tasks, std::size_t index)
+  {
+    using ret_type = typename when_any_variant<T>::type;
+    if constexpr (I + 1 < std::tuple_size_v<T>)
+      if (index != I) return make_variant<I + 1>(std::forward<Tasks>(tasks), index);
+
+    auto&& task = std::get<I>(std::forward<Tasks>(tasks));
+    if constexpr (std::is_void_v<typename std::tuple_element_t<I, T>::value_type>) {
+      task.get();
+      return ret_type(std::in_place_index<I>);
+    } else
+      return ret_type(std::in_place_index<I>, std::forward<decltype(task)>(task).get());
+  }
+
+  template<typename Tasks>
+  static auto make_result(Tasks&& tasks, std::size_t index)
+  {
+    if constexpr (std::ranges::range<T>) {
+      auto& task = tasks[index];
+      using value_type = typename std::ranges::range_value_t<T>::value_type;
+      if constexpr (std::is_void_v<value_type>) {
+        task.get();
+        return when_any_result<void>{index};
+      } else if constexpr (std::is_lvalue_reference_v<Tasks>)
+        return when_any_result<value_type>{index, task.get()};
+      else
+        return when_any_result<value_type>{index, std::move(task).get()};
+    } else
+      return make_variant<0>(std::forward<Tasks>(tasks), index);
+  }
+
+public:
+  explicit when_any_state(T&& tasks) : tasks_(std::move(tasks))
+  {
+    if constexpr (std::ranges::range<T>) slots_.resize(size(tasks_));
+    for (std::size_t i = 0; i < slots_.size(); ++i) slots_[i] = {this, i};
+  }
+
+  void start_all()
+  {
+    acquire(slots_.size());
+    const lazy_stop_token token = start_stop_scope();
+    if constexpr (std::ranges::range<T>) {
+      std::size_t i = 0;
+      for (auto& t : tasks_) t.start(slots_[i++], token);
+    } else
+      [&]<std::size_t... Is>(std::index_sequence<Is...>) {
+        (..., std::get<Is>(tasks_).start(slots_[Is], token));
+      }(std::make_index_sequence<std::tuple_size_v<T>>{});
+  }
+
+  auto result() & { return make_result(tasks_, winner()); }
+  auto result() && { return make_result(std::move(tasks_), winner()); }
+};
+
+template<typename T>
+class when_any_awaitable {
+  when_any_state<T>* state_;
+public:
+  explicit when_any_awaitable(T&& tasks) : state_(new when_any_state<T>(std::move(tasks))) {}
+  when_any_awaitable(when_any_awaitable&& other) noexcept : state_(std::exchange(other.state_, nullptr)) {}
+  when_any_awaitable& operator=(when_any_awaitable&&) = delete;
+  ~when_any_awaitable()
+  {
+    if (state_) state_->release();
+  }
+
+  decltype(auto) operator co_await() &
+  {
+    struct awaiter : awaiter_base {
+      decltype(auto) await_resume()
+      {
+        TRACE_FUNC();
+        return this->state.result();
+      }
+    };
+    return awaiter{{*state_}};
+  }
+
+  decltype(auto) operator co_await() &&
+  {
+    struct awaiter : awaiter_base {
+      decltype(auto) await_resume()
+      {
+        TRACE_FUNC();
+        return std::move(this->state).result();
+      }
+    };
+    return awaiter{{*state_}};
+  }
+
+private:
+  friend void inherit_stop_token(when_any_awaitable& awaitable, const std::stop_token& token) noexcept
+  {
+    awaitable.state_->set_parent_stop_token(token);
+  }
+
+  struct awaiter_base {
+    when_any_state<T>& state;
+
+    bool await_ready() const noexcept
+    {
+      TRACE_FUNC();
+      return state.is_ready();
+    }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      state.start_all();
+      return state.set_continuation(handle);
+    }
+  };
+};
+
+}  // namespace detail
+
+// Resumes the awaiting coroutine as soon as the first of the awaitables completes.
+// Returns a `std::variant` holding the result of the winner at the index of the winning awaitable
+// (`void_type` in place of `void` results and `std::reference_wrapper` for references).
+//
+// The remaining awaitables are not awaited for. A stop is requested for them and they are released when
+// they complete. Rvalue awaitables are moved to the operation state but lvalue ones are referenced so they
+// have to outlive all of the awaitables.
+template<awaitable... Awaitables>
+  requires(sizeof...(Awaitables) > 0)
+awaitable auto when_any(Awaitables&&... awaitables)
+{
+  TRACE_FUNC();
+  return detail::when_any_awaitable(std::make_tuple(
+    detail::make_operation<detail::when_any_slot, Awaitables>(std::forward<Awaitables>(awaitables))...));
+}
+
+// Returns the index and the result of the first completed awaitable from the non-empty range
+template<std::ranges::range R>
+  requires awaitable<std::ranges::range_value_t<R>>
+awaitable auto when_any(R&& awaitables)
+{
+  TRACE_FUNC();
+  assert(!std::ranges::empty(awaitables) && "`when_any` of an empty range never completes");
+  return detail::when_any_awaitable(detail::make_operations<detail::when_any_slot>(std::forward<R>(awaitables)));
+}
+
+}  // namespace mp_coro
@@ -0,0 +1,148 @@
+// The MIT License (MIT)
+//
+// Copyright (c) 2021 Mateusz Pusz
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+
+#pragma once
+
+#include <mp-coro/bits/get_awaiter.h>
+#include <mp-coro/concepts.h>
+#include <mp-coro/timer_service.h>
+#include <mp-coro/trace.h>
+#include <mp-coro/type_traits.h>
+#include <mp-coro/when_any.h>
+#include <chrono>
+#include <coroutine>
+#include <functional>
+#include <stop_token>
+#include <system_error>
+#include <utility>
+#include <variant>
+
+namespace mp_coro {
+
+namespace detail {
+
+template<typename T>
+struct timeout_value {
+  using type = T;
+};
+
+template<typename T>
+struct timeout_value<std::reference_wrapper<T>> {
+  using type = T&;
+};
+
+template<>
+struct timeout_value<void_type> {
+  using type = void;
+};
+
+// Races the awaitable against a timer with `when_any` and unwraps the result of the awaitable
+// or throws when the timer wins
+template<typename W>
+class timeout_awaitable {
+  W race_;
+
+  template<typename Awaiter>
+  struct awaiter {
+    Awaiter race;
+
+    bool await_ready() { return race.await_ready(); }
+    bool await_suspend(std::coroutine_handle<> handle)
+    {
+      TRACE_FUNC();
+      return race.await_suspend(handle);
+    }
+    auto await_resume() -> typename timeout_value<std::variant_alternative_t<0, decltype(race.await_resume())>>::type
+    {
+      TRACE_FUNC();
+      auto result = race.await_resume();
+      if (result.index() != 0) throw std::system_error(std::make_error_code(std::errc::timed_out));
+      if constexpr (!std::is_same_v<std::variant_alternative_t<0, decltype(result)>, void_type>)
+        return std::get<0>(std::move(result));
+    }
+  };
+
+  template<typename Awaiter>
+  static awaiter<Awaiter> make_awaiter(Awaiter&& race)
+  {
+    return {std::forward<Awaiter>(race)};
+  }
+
+public:
+  explicit timeout_awaitable(W&& race) : race_(std::move(race)) {}
+
+  auto operator co_await() & { return make_awaiter(get_awaiter(race_)); }
+  auto operator co_await() && { return make_awaiter(get_awaiter(std::move(race_))); }
+
+private:
+  friend void inherit_stop_token(timeout_awaitable& awaitable, const std::stop_token& token) noexcept
+  {
+    inherit_stop_token(awaitable.race_, token);
+  }
+};
+
+template<typename A>
+auto make_timeout_awaitable(A&& awaitable, timer_service::sleep_awaitable timer)
+{
+  auto race = when_any(std::forward<A>(awaitable), std::move(timer));
+  return timeout_awaitable<decltype(race)>(std::move(race));
+}
+
+}  // namespace detail
+
+// Returns the result of the awaitable or throws `std::system_error` with `std::errc::timed_out` if it does not
+// complete before `deadline`.
+//
+// The awaiting coroutine is resumed as soon as the deadline passes and a stop is requested for the awaitable
+// (see `when_any()` for the lifetime of the abandoned operation). Likewise, the timer is cancelled as soon as
+// the awaitable completes.
+template<awaitable A>
+[[nodiscard]] awaitable auto with_deadline(timer_service& service, A&& awaitable,
+                                           timer_service::clock::time_point deadline)
+{
+  TRACE_FUNC();
+  return detail::make_timeout_awaitable(std::forward<A>(awaitable), service.sleep_until(deadline));
+}
+
+template<awaitable A>
+[[nodiscard]] awaitable auto with_deadline(A&& awaitable, timer_service::clock::time_point deadline)
+{
+  return with_deadline(default_timer_service(), std::forward<A>(awaitable), deadline);
+}
+
+// Same as `with_deadline()` with the deadline of `duration` from now
+template<awaitable A, typename Rep, typename Period>
+[[nodiscard]] awaitable auto with_timeout(timer_service& service, A&& awaitable,
+                                          std::chrono::duration<Rep, Period> duration)
+{
+  TRACE_FUNC();
+  return detail::make_timeout_awaitable(std::forward<A>(awaitable), service.sleep_for(duration));
+}
+
+template<awaitable A, typename Rep, typename Period>
+[[nodiscard]] awaitable auto with_timeout(A&& awaitable, std::chrono::duration<Rep, Period> duration)
+{
+  return with_timeout(default_timer_service(), std::forward<A>(awaitable), duration);
+}
+
+}  // namespace mp_coro